@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ldacdec.h"
+
+/*
+ * A2DP media packets: an RTP header (RFC 3550), then the one byte LDAC media
+ * payload header, then frameCount whole LDAC frames. The payload header
+ * carries fragmentation flags in its top bits, which LDAC sources never set,
+ * and the frame count in its low nibble. Losses show as gaps in the sequence
+ * number, the timestamp counts samples per channel.
+ */
+
+#define RTP_VERSION         (2)
+#define RTP_HEADER_BYTES    (12)
+#define A2DP_FRAGMENTED     (0x80)
+#define A2DP_FRAME_COUNT    (0x0f)
+// a sequence number this far behind the expected one is a late packet,
+// further ahead a loss
+#define SEQUENCE_WINDOW     (0x8000)
+
+struct ldacdec_a2dp {
+    ldacdec_t decoder;
+    int started;
+    uint32_t ssrc;
+    uint16_t nextSequence;
+    uint32_t nextTimestamp;
+    ldacdec_a2dp_stats_t stats;
+};
+
+static uint32_t readBigEndian( const uint8_t *p, int bytes )
+{
+    uint32_t value = 0;
+    for( int i=0; i<bytes; ++i )
+        value = value << 8 | p[i];
+    return value;
+}
+
+// offset of the media payload header, -1 if the RTP header is malformed.
+// end is where the payload stops, before any padding
+static int parseRtp( const uint8_t *packet, int length, ldacdec_packet_t *info, int *end )
+{
+    if( length < RTP_HEADER_BYTES || packet[0] >> 6 != RTP_VERSION )
+        return -1;
+
+    const int padding = packet[0] & 0x20;
+    const int extension = packet[0] & 0x10;
+    const int csrcCount = packet[0] & 0x0f;
+    info->marker = packet[1] >> 7;
+    info->payloadType = packet[1] & 0x7f;
+    info->sequence = readBigEndian( packet + 2, 2 );
+    info->timestamp = readBigEndian( packet + 4, 4 );
+    info->ssrc = readBigEndian( packet + 8, 4 );
+
+    int offset = RTP_HEADER_BYTES + csrcCount * 4;
+    if( extension )
+    {
+        if( offset + 4 > length )
+            return -1;
+        offset += 4 + readBigEndian( packet + offset + 2, 2 ) * 4;
+    }
+    if( padding )
+    {
+        // the last byte counts the padding, itself included
+        if( offset >= length || packet[length - 1] > length - offset )
+            return -1;
+        length -= packet[length - 1];
+    }
+    *end = length;
+    return offset < length ? offset : -1;
+}
+
+ldacdec_a2dp_t *ldacdecA2dpCreate( void )
+{
+    ldacdec_a2dp_t *this = malloc( sizeof(*this) );
+    if( this != NULL )
+        ldacdecA2dpReset( this );
+    return this;
+}
+
+void ldacdecA2dpDestroy( ldacdec_a2dp_t *this )
+{
+    free( this );
+}
+
+void ldacdecA2dpReset( ldacdec_a2dp_t *this )
+{
+    memset( this, 0, sizeof(*this) );
+    ldacdecInit( &this->decoder );
+}
+
+int ldacdecA2dpDecode( ldacdec_a2dp_t *this, const uint8_t *packet, int length, int16_t *pcm, ldacdec_packet_t *info )
+{
+    ldacdec_packet_t local;
+    if( info == NULL )
+        info = &local;
+    memset( info, 0, sizeof(*info) );
+    this->stats.packets++;
+
+    int end = length;
+    const int offset = parseRtp( packet, length, info, &end );
+    if( offset < 0 || ( packet[offset] & A2DP_FRAGMENTED ) )
+    {
+        this->stats.invalidPackets++;
+        return -1;
+    }
+    info->frameCount = packet[offset] & A2DP_FRAME_COUNT;
+
+    // a new source starts over, without counting losses
+    if( !this->started || info->ssrc != this->ssrc )
+    {
+        ldacdecInit( &this->decoder );
+        this->started = 1;
+        this->ssrc = info->ssrc;
+    }
+    else
+    {
+        const uint16_t gap = info->sequence - this->nextSequence;
+        if( gap >= SEQUENCE_WINDOW )
+        {
+            this->stats.latePackets++;
+            return LDACDEC_ERR_LATE;
+        }
+        info->lostPackets = gap;
+        info->lostSamples = gap ? (int32_t)( info->timestamp - this->nextTimestamp ) : 0;
+        this->stats.lostPackets += gap;
+    }
+
+    // all frames of the packet in one call
+    int frames = 0;
+    int bytes = 0;
+    const int ret = ldacDecodeFrames( &this->decoder, packet + offset + 1, end - offset - 1,
+        pcm, info->frameCount, &frames, &bytes );
+    const int samples = frames * ldacdecGetOutputSamples( &this->decoder );
+    info->samples = samples;
+    this->stats.frames += frames;
+
+    this->nextSequence = info->sequence + 1;
+    this->nextTimestamp = info->timestamp + samples;
+    if( frames < info->frameCount )
+    {
+        this->stats.invalidPackets++;
+        // the frames before the broken one are still good
+        if( frames == 0 )
+            return ret < 0 ? ret : LDACDEC_ERR_TRUNCATED;
+    }
+    return samples;
+}
+
+int ldacdecA2dpGetSampleRate( ldacdec_a2dp_t *this )
+{
+    return ldacdecGetSampleRate( &this->decoder );
+}
+
+int ldacdecA2dpGetChannelCount( ldacdec_a2dp_t *this )
+{
+    return ldacdecGetChannelCount( &this->decoder );
+}
+
+void ldacdecA2dpGetStats( ldacdec_a2dp_t *this, ldacdec_a2dp_stats_t *stats )
+{
+    *stats = this->stats;
+}
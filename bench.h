@@ -0,0 +1,34 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Helpers shared by the bench tools.
+ */
+
+// writes fields MSB first, as the bit reader takes them. data starts zeroed
+typedef struct {
+    uint8_t *data;
+    int position;
+} bit_writer_t;
+
+static inline void putBits( bit_writer_t *this, uint32_t value, int bits )
+{
+    for( int i=bits-1; i>=0; --i, ++this->position )
+    {
+        if( ( value >> i ) & 1 )
+            this->data[this->position / 8] |= 0x80 >> ( this->position % 8 );
+    }
+}
+
+// monotonic seconds
+static inline double now( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#endif // _BENCH_H_
@@ -1,17 +1,191 @@
 #pragma once
 
 #include <stdint.h>
+#include <string.h>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+ * MSB first bit reader over Size bytes. Cache holds the next CacheBits bits
+ * from Position on, left aligned. A refill is one unaligned 64 bit load while
+ * 8 bytes remain, near the end the remaining bytes are assembled one by one.
+ * Reads past the end never touch memory and return zero bits, but still
+ * advance Position, which BitReaderOverrun() reports.
+ */
 typedef struct {
 	const uint8_t * Buffer;
+	int Size;
 	int Position;
+	int CacheBits;
+	uint64_t Cache;
 } BitReaderCxt;
 
 // Make MSVC compiler happy. Leave const in for value parameters
 
-void InitBitReaderCxt(BitReaderCxt* br, const void * buffer);
-uint32_t PeekInt(BitReaderCxt* br, const int bits);
-uint32_t ReadInt(BitReaderCxt* br, const int bits);
-int32_t ReadSignedInt(BitReaderCxt* br, const int bits);
-int32_t ReadOffsetBinary(BitReaderCxt* br, const int bits);
-void AlignPosition(BitReaderCxt* br, const unsigned int multiple);
+static inline void InitBitReaderCxt(BitReaderCxt* br, const void * buffer, const int size)
+{
+	br->Buffer = buffer;
+	br->Size = size;
+	br->Position = 0;
+	br->CacheBits = 0;
+	br->Cache = 0;
+}
+
+static inline uint64_t LoadBigEndian64(const uint8_t* p)
+{
+	uint64_t value;
+	memcpy(&value, p, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	value = __builtin_bswap64(value);
+#endif
+	return value;
+}
+
+static inline uint64_t LoadBigEndianTail(const uint8_t* p, int count)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		value = value << 8 | (i < count ? p[i] : 0);
+	}
+	return value;
+}
+
+static inline void RefillBitCache(BitReaderCxt* br)
+{
+	const int byteIndex = br->Position / 8;
+	const int bitIndex = br->Position % 8;
+	const int remaining = br->Size - byteIndex;
+	uint64_t value;
+
+	if (__builtin_expect(remaining >= 8, 1))
+	{
+		value = LoadBigEndian64(br->Buffer + byteIndex);
+	}
+	else
+	{
+		value = remaining > 0 ? LoadBigEndianTail(br->Buffer + byteIndex, remaining) : 0;
+	}
+	br->Cache = value << bitIndex;
+	br->CacheBits = 64 - bitIndex;
+}
+
+static inline int BitReaderOverrun(const BitReaderCxt* br)
+{
+	return br->Position > br->Size * 8;
+}
+
+/* up to 32 bits */
+static inline uint32_t PeekInt(BitReaderCxt* br, const int bits)
+{
+	if (br->CacheBits < bits)
+	{
+		RefillBitCache(br);
+	}
+	// two shifts so bits == 0 is defined
+	return (uint32_t)((br->Cache >> 1) >> (63 - bits));
+}
+
+/* only after a PeekInt() of at least bits */
+static inline void SkipBits(BitReaderCxt* br, const int bits)
+{
+	br->Position += bits;
+	br->CacheBits -= bits;
+	br->Cache <<= bits;
+}
+
+static inline uint32_t ReadInt(BitReaderCxt* br, const int bits)
+{
+	const uint32_t value = PeekInt(br, bits);
+	SkipBits(br, bits);
+	return value;
+}
+
+static inline int32_t ReadSignedInt(BitReaderCxt* br, const int bits)
+{
+	if (br->CacheBits < bits)
+	{
+		RefillBitCache(br);
+	}
+	const int64_t value = (int64_t)br->Cache >> (64 - bits);
+	SkipBits(br, bits);
+	return (int32_t)value;
+}
+
+#ifdef __AVX2__
+/*
+ * Unpacks 4 or 8 values of bits <= 16 each, starting bitIndex bits into
+ * lowByte. Every lane picks the 4 bytes holding its value with a byte shuffle,
+ * lanes 4 to 7 from a second load at highByte, then shifts it to the top and
+ * sign extends it down.
+ */
+static inline __m256i UnpackSigned8(const uint8_t* lowByte, const uint8_t* highByte, int bitIndex, __m256i laneBits, int bits)
+{
+	const int highOffset = (int)(highByte - lowByte) * 8;
+	const __m256i offset = _mm256_sub_epi32(_mm256_add_epi32(laneBits, _mm256_set1_epi32(bitIndex)),
+		_mm256_setr_epi32(0, 0, 0, 0, highOffset, highOffset, highOffset, highOffset));
+	const __m256i byte = _mm256_srli_epi32(offset, 3);
+	const __m256i broadcast = _mm256_setr_epi8(0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12, 0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12);
+	const __m256i shuffle = _mm256_add_epi8(_mm256_shuffle_epi8(byte, broadcast), _mm256_set1_epi32(0x00010203));
+	const __m256i data = _mm256_loadu2_m128i((const __m128i*)highByte, (const __m128i*)lowByte);
+	const __m256i words = _mm256_sllv_epi32(_mm256_shuffle_epi8(data, shuffle), _mm256_and_si256(offset, _mm256_set1_epi32(7)));
+	return _mm256_sra_epi32(words, _mm_cvtsi32_si128(32 - bits));
+}
+#endif
+
+/*
+ * count values of bits each, as ReadSignedInt() would return them one by one.
+ * With AVX2, multiples of 4 values of up to 16 bits are unpacked 8 at a time
+ * while the loads stay 16 bytes clear of the end.
+ */
+static inline void ReadSignedInts(BitReaderCxt* br, int32_t* values, const int count, const int bits)
+{
+	int i = 0;
+#ifdef __AVX2__
+	if (bits <= 16 && count % 4 == 0 && br->Position / 8 + count * bits / 8 + 16 <= br->Size)
+	{
+		const __m256i laneBits = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(bits));
+		for (; i + 8 <= count; i += 8)
+		{
+			const int position = br->Position;
+			const uint8_t* low = br->Buffer + position / 8;
+			const uint8_t* high = br->Buffer + (position + 4 * bits) / 8;
+			_mm256_storeu_si256((__m256i*)(values + i), UnpackSigned8(low, high, position % 8, laneBits, bits));
+			br->Position += 8 * bits;
+		}
+		if (i < count)
+		{
+			const int position = br->Position;
+			const uint8_t* low = br->Buffer + position / 8;
+			_mm_storeu_si128((__m128i*)(values + i), _mm256_castsi256_si128(UnpackSigned8(low, low, position % 8, laneBits, bits)));
+			br->Position += 4 * bits;
+			i += 4;
+		}
+		br->CacheBits = 0;
+	}
+#endif
+	for (; i < count; i++)
+	{
+		values[i] = ReadSignedInt(br, bits);
+	}
+}
+
+static inline int32_t ReadOffsetBinary(BitReaderCxt* br, const int bits)
+{
+	const int offset = 1 << (bits - 1);
+	return (int32_t)ReadInt(br, bits) - offset;
+}
+
+static inline void AlignPosition(BitReaderCxt* br, const unsigned int multiple)
+{
+	const int position = br->Position;
+	if (position % multiple == 0)
+	{
+		return;
+	}
+
+	br->Position = position + multiple - position % multiple;
+	br->CacheBits = 0;
+}
@@ -0,0 +1,73 @@
+#include "ldacdec.h"
+#include "spectrum.h"
+#include "pcm.h"
+
+/*
+ * Load time selection of the kernel variants dispatch.h names. Each exported
+ * function of the kernel files is a GNU ifunc, its resolver runs while the
+ * library is relocated and returns the variant for the best psABI level the
+ * CPU supports. That is before constructors, so the resolvers only use the
+ * compiler's cpuid based CPU model, which __builtin_cpu_init() sets up.
+ *
+ * There is no AVX-512 variant. The kernels are written with AVX2 intrinsics
+ * at most, and an x86-64-v4 build of them only differed in what the compiler
+ * vectorized by itself, so AVX-512 CPUs run the AVX2 kernels.
+ */
+
+#ifdef KERNEL_DISPATCH
+
+// in the order of the psABI levels, the Makefile's KERNEL_VARIANTS
+enum {
+    KERNEL_X86_64,
+    KERNEL_SSE4_2,
+    KERNEL_AVX2,
+};
+
+static const char *kernelNames[] = { "x86-64", "sse4.2", "avx2" };
+
+static int kernelVariant( void )
+{
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "x86-64-v3" ) )
+        return KERNEL_AVX2;
+    if( __builtin_cpu_supports( "x86-64-v2" ) )
+        return KERNEL_SSE4_2;
+    return KERNEL_X86_64;
+}
+
+#define DISPATCH( name )                                                        \
+    extern __typeof__( name ) name##_x86_64, name##_sse4_2, name##_avx2;       \
+    static __typeof__( name ) *resolve_##name( void )                           \
+    {                                                                           \
+        __typeof__( name ) *variants[] = { name##_x86_64, name##_sse4_2, name##_avx2 }; \
+        return variants[kernelVariant()];                                       \
+    }                                                                           \
+    __typeof__( name ) name __attribute__((ifunc( "resolve_" #name )));
+
+DISPATCH( RunImdct )
+DISPATCH( RunImdctLanes )
+DISPATCH( RunImdctReference )
+
+DISPATCH( decodeSpectrum )
+DISPATCH( decodeSpectrumFine )
+DISPATCH( dequantizeSpectra )
+DISPATCH( dequantizeSpectraFixed )
+DISPATCH( dequantizeSpectraLanes )
+
+DISPATCH( pcmConvert )
+DISPATCH( pcmConvertReference )
+DISPATCH( pcmConvertFixed )
+
+const char *ldacdecGetKernelVariant( void )
+{
+    return kernelNames[kernelVariant()];
+}
+
+#else
+
+const char *ldacdecGetKernelVariant( void )
+{
+    return "native";
+}
+
+#endif // KERNEL_DISPATCH
@@ -0,0 +1,33 @@
+#ifndef _DISPATCH_H_
+#define _DISPATCH_H_
+
+/*
+ * x86-64 builds compile imdct.c, spectrum.c and pcm.c once per KERNEL_VARIANT,
+ * each for its own psABI level. Every function they export gets the variant
+ * as suffix here, dispatch.c resolves the plain names to the best variant the
+ * CPU runs when the library is loaded. Helpers with nothing to vectorize
+ * are built only with KERNEL_BASELINE, the variant for plain x86-64, and
+ * keep their names.
+ */
+#ifdef KERNEL_VARIANT
+
+#define KERNEL_PASTE( name, variant )   name##_##variant
+#define KERNEL_NAME( name, variant )    KERNEL_PASTE( name, variant )
+
+#define RunImdct                KERNEL_NAME( RunImdct, KERNEL_VARIANT )
+#define RunImdctLanes           KERNEL_NAME( RunImdctLanes, KERNEL_VARIANT )
+#define RunImdctReference       KERNEL_NAME( RunImdctReference, KERNEL_VARIANT )
+
+#define decodeSpectrum          KERNEL_NAME( decodeSpectrum, KERNEL_VARIANT )
+#define decodeSpectrumFine      KERNEL_NAME( decodeSpectrumFine, KERNEL_VARIANT )
+#define dequantizeSpectra       KERNEL_NAME( dequantizeSpectra, KERNEL_VARIANT )
+#define dequantizeSpectraFixed  KERNEL_NAME( dequantizeSpectraFixed, KERNEL_VARIANT )
+#define dequantizeSpectraLanes  KERNEL_NAME( dequantizeSpectraLanes, KERNEL_VARIANT )
+
+#define pcmConvert              KERNEL_NAME( pcmConvert, KERNEL_VARIANT )
+#define pcmConvertReference     KERNEL_NAME( pcmConvertReference, KERNEL_VARIANT )
+#define pcmConvertFixed         KERNEL_NAME( pcmConvertFixed, KERNEL_VARIANT )
+
+#endif // KERNEL_VARIANT
+
+#endif // _DISPATCH_H_
@@ -0,0 +1,349 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ldacdec.h"
+
+/*
+ * Multi-stream engine. Frames are queued per stream, and a stream with queued
+ * frames is a task in exactly one worker deque or being run by exactly one
+ * worker. That keeps the frames of a stream in order and its IMDCT overlap
+ * with a single thread at a time, while different streams spread over the
+ * pool. A worker runs its own deque newest first and steals the oldest task
+ * of another deque when its own is empty. A stream task decodes up to
+ * ENGINE_BATCH frames and then goes back to the deque, so a busy stream does
+ * not starve the others.
+ */
+
+// queued frames per stream
+#define ENGINE_QUEUE        (16)
+// frames per stream task before it yields
+#define ENGINE_BATCH        (4)
+
+typedef struct {
+    uint8_t data[LDACDEC_MAX_FRAME_BYTES];
+    int length;
+    void *tag;
+} engine_frame_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    engine_frame_t queue[ENGINE_QUEUE];
+    int head;
+    int count;
+    // in a deque or being run
+    int scheduled;
+
+    ldacdec_t decoder;
+    int16_t pcm[2 * MAX_FRAME_SAMPLES];
+} engine_stream_t;
+
+// stream ids, the owner works at bottom, thieves take from top. A stream is
+// in at most one deque, so streamCount entries never overflow. top and bottom
+// only grow and wrap around, the capacity is a power of two so the masked
+// index stays continuous when they do
+typedef struct {
+    pthread_mutex_t lock;
+    int *tasks;
+    unsigned mask;
+    unsigned top;
+    unsigned bottom;
+} engine_deque_t;
+
+struct ldacdec_engine {
+    int streamCount;
+    engine_stream_t *streams;
+    int workerCount;
+    int dequeCount;
+    int threadCount;
+    engine_deque_t *deques;
+    pthread_t *threads;
+
+    ldacdec_engine_callback_t callback;
+    void *user;
+
+    // stream tasks in all deques, and frames submitted but not yet called back
+    atomic_int queued;
+    atomic_int outstanding;
+    atomic_uint nextDeque;
+    int quit;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t idle;
+};
+
+typedef struct {
+    ldacdec_engine_t *engine;
+    int index;
+} engine_worker_t;
+
+static void dequePush( engine_deque_t *this, int stream )
+{
+    pthread_mutex_lock( &this->lock );
+    this->tasks[this->bottom++ & this->mask] = stream;
+    pthread_mutex_unlock( &this->lock );
+}
+
+static int dequePop( engine_deque_t *this )
+{
+    int stream = -1;
+    pthread_mutex_lock( &this->lock );
+    if( this->bottom != this->top )
+        stream = this->tasks[--this->bottom & this->mask];
+    pthread_mutex_unlock( &this->lock );
+    return stream;
+}
+
+static int dequeSteal( engine_deque_t *this )
+{
+    int stream = -1;
+    pthread_mutex_lock( &this->lock );
+    if( this->bottom != this->top )
+        stream = this->tasks[this->top++ & this->mask];
+    pthread_mutex_unlock( &this->lock );
+    return stream;
+}
+
+static void schedule( ldacdec_engine_t *this, int deque, int stream )
+{
+    atomic_fetch_add( &this->queued, 1 );
+    dequePush( &this->deques[deque], stream );
+
+    pthread_mutex_lock( &this->lock );
+    pthread_cond_signal( &this->work );
+    pthread_mutex_unlock( &this->lock );
+}
+
+// own deque first, then the others starting at the next worker
+static int findTask( ldacdec_engine_t *this, int worker )
+{
+    for( int i=0; i<this->workerCount; ++i )
+    {
+        engine_deque_t *deque = &this->deques[(worker + i) % this->workerCount];
+        const int stream = i == 0 ? dequePop( deque ) : dequeSteal( deque );
+        if( stream >= 0 )
+        {
+            atomic_fetch_sub( &this->queued, 1 );
+            return stream;
+        }
+    }
+    return -1;
+}
+
+static void runStream( ldacdec_engine_t *this, int worker, int streamNbr )
+{
+    engine_stream_t *stream = &this->streams[streamNbr];
+    const frame_t *frame = &stream->decoder.frame;
+
+    for( int frames = 0; ; ++frames )
+    {
+        pthread_mutex_lock( &stream->lock );
+        if( stream->count == 0 )
+        {
+            stream->scheduled = 0;
+            pthread_mutex_unlock( &stream->lock );
+            return;
+        }
+        if( frames == ENGINE_BATCH )
+        {
+            pthread_mutex_unlock( &stream->lock );
+            schedule( this, worker, streamNbr );
+            return;
+        }
+        // submitters only write free slots, this one stays put until count drops
+        engine_frame_t *queued = &stream->queue[stream->head];
+        pthread_mutex_unlock( &stream->lock );
+
+        const int ret = ldacDecodeBuffer( &stream->decoder, queued->data, queued->length, stream->pcm, NULL );
+        this->callback( this->user, streamNbr, queued->tag, ret, stream->pcm,
+            ret < 0 ? 0 : frame->frameSamples, ret < 0 ? 0 : frame->channelCount );
+
+        pthread_mutex_lock( &stream->lock );
+        stream->head = (stream->head + 1) % ENGINE_QUEUE;
+        stream->count--;
+        pthread_mutex_unlock( &stream->lock );
+
+        if( atomic_fetch_sub( &this->outstanding, 1 ) == 1 )
+        {
+            pthread_mutex_lock( &this->lock );
+            pthread_cond_broadcast( &this->idle );
+            pthread_mutex_unlock( &this->lock );
+        }
+    }
+}
+
+static void *workerThread( void *arg )
+{
+    engine_worker_t *worker = arg;
+    ldacdec_engine_t *this = worker->engine;
+
+    for(;;)
+    {
+        const int stream = findTask( this, worker->index );
+        if( stream >= 0 )
+        {
+            runStream( this, worker->index, stream );
+            continue;
+        }
+
+        // a stream scheduled after findTask() came back empty is still
+        // queued, so quit only ends a worker once the deques are drained
+        pthread_mutex_lock( &this->lock );
+        while( atomic_load( &this->queued ) == 0 && !this->quit )
+            pthread_cond_wait( &this->work, &this->lock );
+        const int quit = this->quit && atomic_load( &this->queued ) == 0;
+        pthread_mutex_unlock( &this->lock );
+        if( quit )
+            break;
+    }
+    free( worker );
+    return NULL;
+}
+
+ldacdec_engine_t *ldacdecEngineCreate( int workers, int streams, ldacdec_engine_callback_t callback, void *user )
+{
+    if( workers < 1 || streams < 1 || callback == NULL )
+        return NULL;
+
+    ldacdec_engine_t *this = calloc( 1, sizeof(*this) );
+    if( this == NULL )
+        return NULL;
+    this->workerCount = workers;
+    this->callback = callback;
+    this->user = user;
+    atomic_init( &this->queued, 0 );
+    atomic_init( &this->outstanding, 0 );
+    atomic_init( &this->nextDeque, 0 );
+    pthread_mutex_init( &this->lock, NULL );
+    pthread_cond_init( &this->work, NULL );
+    pthread_cond_init( &this->idle, NULL );
+
+    // the counts follow what is initialized, so a failure anywhere leaves
+    // ldacdecEngineDestroy() exactly the parts to tear down
+    this->streams = calloc( streams, sizeof(*this->streams) );
+    this->deques = calloc( workers, sizeof(*this->deques) );
+    this->threads = calloc( workers, sizeof(*this->threads) );
+    if( this->streams == NULL || this->deques == NULL || this->threads == NULL )
+        goto fail;
+
+    for( int i=0; i<streams; ++i )
+    {
+        pthread_mutex_init( &this->streams[i].lock, NULL );
+        ldacdecInit( &this->streams[i].decoder );
+        this->streamCount = i + 1;
+    }
+    unsigned capacity = 1;
+    while( capacity < (unsigned)streams )
+        capacity *= 2;
+    for( int i=0; i<workers; ++i )
+    {
+        pthread_mutex_init( &this->deques[i].lock, NULL );
+        this->deques[i].mask = capacity - 1;
+        this->deques[i].tasks = malloc( capacity * sizeof(int) );
+        this->dequeCount = i + 1;
+        if( this->deques[i].tasks == NULL )
+            goto fail;
+    }
+
+    for( int i=0; i<workers; ++i )
+    {
+        engine_worker_t *worker = malloc( sizeof(*worker) );
+        if( worker != NULL )
+        {
+            worker->engine = this;
+            worker->index = i;
+        }
+        if( worker == NULL || pthread_create( &this->threads[i], NULL, workerThread, worker ) != 0 )
+        {
+            free( worker );
+            goto fail;
+        }
+        this->threadCount = i + 1;
+    }
+    return this;
+
+fail:
+    ldacdecEngineDestroy( this );
+    return NULL;
+}
+
+void ldacdecEngineDestroy( ldacdec_engine_t *this )
+{
+    if( this == NULL )
+        return;
+
+    pthread_mutex_lock( &this->lock );
+    this->quit = 1;
+    pthread_cond_broadcast( &this->work );
+    pthread_mutex_unlock( &this->lock );
+    for( int i=0; i<this->threadCount; ++i )
+        pthread_join( this->threads[i], NULL );
+
+    for( int i=0; i<this->streamCount; ++i )
+        pthread_mutex_destroy( &this->streams[i].lock );
+    for( int i=0; i<this->dequeCount; ++i )
+    {
+        pthread_mutex_destroy( &this->deques[i].lock );
+        free( this->deques[i].tasks );
+    }
+    pthread_cond_destroy( &this->idle );
+    pthread_cond_destroy( &this->work );
+    pthread_mutex_destroy( &this->lock );
+    free( this->threads );
+    free( this->deques );
+    free( this->streams );
+    free( this );
+}
+
+int ldacdecEngineSubmit( ldacdec_engine_t *this, int streamNbr, const uint8_t *data, int length, void *tag )
+{
+    if( streamNbr < 0 || streamNbr >= this->streamCount || length < 0 )
+        return -1;
+
+    engine_stream_t *stream = &this->streams[streamNbr];
+    pthread_mutex_lock( &stream->lock );
+    if( stream->count == ENGINE_QUEUE )
+    {
+        pthread_mutex_unlock( &stream->lock );
+        return LDACDEC_ERR_BUSY;
+    }
+
+    engine_frame_t *queued = &stream->queue[(stream->head + stream->count) % ENGINE_QUEUE];
+    // a frame never exceeds LDACDEC_MAX_FRAME_BYTES, the rest is not read anyway
+    queued->length = min( length, LDACDEC_MAX_FRAME_BYTES );
+    memcpy( queued->data, data, queued->length );
+    queued->tag = tag;
+    stream->count++;
+    atomic_fetch_add( &this->outstanding, 1 );
+
+    const int idle = !stream->scheduled;
+    stream->scheduled = 1;
+    pthread_mutex_unlock( &stream->lock );
+
+    if( idle )
+        schedule( this, atomic_fetch_add( &this->nextDeque, 1 ) % this->workerCount, streamNbr );
+    return 0;
+}
+
+void ldacdecEngineFlush( ldacdec_engine_t *this )
+{
+    pthread_mutex_lock( &this->lock );
+    while( atomic_load( &this->outstanding ) != 0 )
+        pthread_cond_wait( &this->idle, &this->lock );
+    pthread_mutex_unlock( &this->lock );
+}
+
+int ldacdecEngineReset( ldacdec_engine_t *this, int streamNbr )
+{
+    if( streamNbr < 0 || streamNbr >= this->streamCount )
+        return -1;
+
+    engine_stream_t *stream = &this->streams[streamNbr];
+    pthread_mutex_lock( &stream->lock );
+    const int busy = stream->scheduled;
+    if( !busy )
+        ldacdecInit( &stream->decoder );
+    pthread_mutex_unlock( &stream->lock );
+    return busy ? LDACDEC_ERR_BUSY : 0;
+}
@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+#include "ldacdec.h"
+
+/*
+ * Checks that ldacdecEngineDestroy() without a flush still calls back every
+ * frame submitted, in order per stream. The frames are not valid LDAC, each
+ * one fails to decode fast, which keeps the workers going idle while frames
+ * are still being submitted.
+ */
+
+#define TEST_STREAMS    (7)
+#define TEST_FRAMES     (300)
+#define TEST_ROUNDS     (20)
+#define TEST_WORKERS    (4)
+
+typedef struct {
+    atomic_int calls[TEST_STREAMS];
+    atomic_int disorder;
+    intptr_t next[TEST_STREAMS];
+} test_t;
+
+static void callback( void *user, int stream, void *tag, int status, const int16_t *pcm, int frameSamples, int channelCount )
+{
+    test_t *this = user;
+    (void)status;
+    (void)pcm;
+    (void)frameSamples;
+    (void)channelCount;
+    // a stream is run by one worker at a time, next[] needs no lock
+    if( (intptr_t)tag != this->next[stream]++ )
+        atomic_fetch_add( &this->disorder, 1 );
+    atomic_fetch_add( &this->calls[stream], 1 );
+}
+
+static int runRound( int workers )
+{
+    static const uint8_t frame[LDACDEC_MAX_FRAME_BYTES];
+    static test_t test;
+    for( int i=0; i<TEST_STREAMS; ++i )
+    {
+        atomic_init( &test.calls[i], 0 );
+        test.next[i] = 0;
+    }
+    atomic_init( &test.disorder, 0 );
+
+    ldacdec_engine_t *engine = ldacdecEngineCreate( workers, TEST_STREAMS, callback, &test );
+    if( engine == NULL )
+    {
+        printf("can't create an engine with %d workers\n", workers );
+        return -1;
+    }
+    for( intptr_t frameNbr = 0; frameNbr < TEST_FRAMES; ++frameNbr )
+    {
+        for( int stream=0; stream<TEST_STREAMS; ++stream )
+        {
+            while( ldacdecEngineSubmit( engine, stream, frame, sizeof(frame), (void *)frameNbr ) == LDACDEC_ERR_BUSY )
+                sched_yield();
+        }
+    }
+    ldacdecEngineDestroy( engine );
+
+    int failed = atomic_load( &test.disorder ) != 0;
+    for( int i=0; i<TEST_STREAMS; ++i )
+    {
+        const int calls = atomic_load( &test.calls[i] );
+        if( calls != TEST_FRAMES )
+        {
+            printf("%d workers, stream %d: %d of %d frames called back\n", workers, i, calls, TEST_FRAMES );
+            failed = 1;
+        }
+    }
+    if( atomic_load( &test.disorder ) != 0 )
+        printf("%d workers: %d frames called back out of order\n", workers, atomic_load( &test.disorder ) );
+    return failed ? -1 : 0;
+}
+
+int main( void )
+{
+    int failed = 0;
+    for( int workers=1; workers<=TEST_WORKERS; ++workers )
+    {
+        for( int round=0; round<TEST_ROUNDS; ++round )
+        {
+            if( runRound( workers ) < 0 )
+            {
+                failed = 1;
+                break;
+            }
+        }
+    }
+    printf( failed ? "engine drain: FAILED\n" : "engine drain: ok\n" );
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
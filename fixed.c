@@ -0,0 +1,198 @@
+#include <math.h>
+#include <stdint.h>
+
+#include "ldacdec.h"
+#include "utility.h"
+
+#ifdef GENERATE_TABLES
+#include "gentables.h"
+#endif
+
+/*
+ * Dct4Scalar() and ImdctOverlapScalar() in integer arithmetic. Twiddles are
+ * Q31 and the window Q30, each product is 64 bit and rounded once per output
+ * value. A rotation keeps the magnitude of a complex pair and each butterfly
+ * stage at most doubles it, so an input below 2^(30 - Bits) cannot overflow
+ * the 32 bit butterflies. Louder spectra are shifted down by the missing bits
+ * first and scaled back up in the window stage.
+ */
+
+#ifndef GENERATE_TABLES
+
+/*
+ * FixedSinTables and FixedCosTables (Q31), FixedWindow (Q30) and
+ * FixedShuffleTables for 128 and 256 points, written by gentables.
+ */
+#include "fixedTables.h"
+
+#else
+
+static int FixedSinTables[9][256];
+static int FixedCosTables[9][256];
+static int FixedWindow[2][256];
+static int FixedShuffleTables[2][256];
+
+static int ToFixed(double value, int fractionBits)
+{
+	const double scaled = round(ldexp(value, fractionBits));
+	return scaled >= INT32_MAX ? INT32_MAX : (int)scaled;
+}
+
+static double WindowValue(int i, int frameSize)
+{
+	return (sin(((i + 0.5) / frameSize - 0.5) * M_PI) + 1.0) * 0.5;
+}
+
+static void WriteIntTable(FILE* out, const char* name, const int* values, int rows, int columns)
+{
+	fprintf(out, "\nstatic const int32_t %s[%d][%d] = {\n", name, rows, columns);
+	for (int i = 0; i < rows; i++)
+	{
+		WriteInts(out, values + i * columns, columns);
+		fprintf(out, ",\n");
+	}
+	fprintf(out, "};\n");
+}
+
+/* the same values imdct.c generates in double, rounded to fixed point */
+void WriteFixedTables(FILE* out)
+{
+	for (int bits = 0; bits < 9; bits++)
+	{
+		const int size = 1 << bits;
+		for (int i = 0; i < size; i++)
+		{
+			const double value = M_PI * (4 * i + 1) / (4 * size);
+			FixedSinTables[bits][i] = ToFixed(sin(value), 31);
+			FixedCosTables[bits][i] = ToFixed(cos(value), 31);
+		}
+	}
+	for (int bits = 7; bits <= 8; bits++)
+	{
+		const int size = 1 << bits;
+		for (int i = 0; i < size; i++)
+		{
+			const double a = WindowValue(i, size);
+			const double b = WindowValue(size - 1 - i, size);
+			FixedWindow[bits - 7][i] = ToFixed(a / (b * b + a * a), 30);
+			FixedShuffleTables[bits - 7][i] = BitReverse32(i ^ (i / 2), bits);
+		}
+	}
+
+	fprintf(out, "/* generated by gentables, do not edit */\n");
+	WriteIntTable(out, "FixedSinTables", FixedSinTables[0], 9, 256);
+	WriteIntTable(out, "FixedCosTables", FixedCosTables[0], 9, 256);
+	WriteIntTable(out, "FixedWindow", FixedWindow[0], 2, 256);
+	WriteIntTable(out, "FixedShuffleTables", FixedShuffleTables[0], 2, 256);
+}
+
+#endif // GENERATE_TABLES
+
+
+static inline int32_t Saturate32(int64_t value)
+{
+	return value > INT32_MAX ? INT32_MAX : value < -INT32_MAX ? -INT32_MAX : (int32_t)value;
+}
+
+/* value / 2^shift, rounded half up */
+static inline int64_t RoundShift(int64_t value, int shift)
+{
+	return (value + ((int64_t)1 << (shift - 1))) >> shift;
+}
+
+static inline int32_t Rotate(int32_t a, int32_t b, int32_t x, int32_t y)
+{
+	return (int32_t)RoundShift((int64_t)a * x + (int64_t)b * y, 31);
+}
+
+/* bits the input has to be shifted down for the butterflies to fit in 32 bit */
+static int HeadroomShift(const int32_t* input, int size, int bits)
+{
+	uint32_t peak = 0;
+	for (int i = 0; i < size; i++)
+	{
+		peak |= (uint32_t)(input[i] < 0 ? -(int64_t)input[i] : input[i]);
+	}
+	int shift = 0;
+	while (peak >> shift >= (uint32_t)1 << (30 - bits))
+	{
+		shift++;
+	}
+	return shift;
+}
+
+static void ButterflyStageFixed(int32_t* dctTemp, int blockCount, int blockSizeBits)
+{
+	int blockHalfSizeBits = blockSizeBits - 1;
+	int blockSize = 1 << blockSizeBits;
+	int blockHalfSize = 1 << blockHalfSizeBits;
+	const int32_t* sinTable = FixedSinTables[blockHalfSizeBits];
+	const int32_t* cosTable = FixedCosTables[blockHalfSizeBits];
+
+	for (int block = 0; block < blockCount; block++)
+	{
+		for (int i = 0; i < blockHalfSize; i++)
+		{
+			int frontPos = (block * blockSize + i) * 2;
+			int backPos = frontPos + blockSize;
+			int32_t a = dctTemp[frontPos] - dctTemp[backPos];
+			int32_t b = dctTemp[frontPos + 1] - dctTemp[backPos + 1];
+			dctTemp[frontPos] += dctTemp[backPos];
+			dctTemp[frontPos + 1] += dctTemp[backPos + 1];
+			dctTemp[backPos] = Rotate(a, b, cosTable[i], sinTable[i]);
+			dctTemp[backPos + 1] = Rotate(a, -b, sinTable[i], cosTable[i]);
+		}
+	}
+}
+
+/* DCT-IV of input >> shift, not yet shuffled */
+static void Dct4Fixed(int bits, int shift, const int32_t* input, int32_t* dctTemp)
+{
+	const int size = 1 << bits;
+	const int lastIndex = size - 1;
+	const int32_t* sinTable = FixedSinTables[bits];
+	const int32_t* cosTable = FixedCosTables[bits];
+
+	for (int i = 0; i < size / 2; i++)
+	{
+		int i2 = i * 2;
+		int32_t a = shift ? (int32_t)RoundShift(input[i2], shift) : input[i2];
+		int32_t b = shift ? (int32_t)RoundShift(input[lastIndex - i2], shift) : input[lastIndex - i2];
+		dctTemp[i2] = Rotate(a, b, cosTable[i], sinTable[i]);
+		dctTemp[i2 + 1] = Rotate(a, -b, sinTable[i], cosTable[i]);
+	}
+	int stageCount = bits - 1;
+
+	for (int stage = 0; stage < stageCount; stage++)
+	{
+		ButterflyStageFixed(dctTemp, 1 << stage, stageCount - stage);
+	}
+}
+
+/* Q30 window times a DCT value shifted down by shift, back in Q(FIXED_FRAC_BITS) */
+static inline int64_t Windowed(int32_t window, int64_t value, int shift)
+{
+	return RoundShift(window * value, 30 - shift);
+}
+
+void RunImdctFixed(MdctFixed* mdct, const int32_t* input, int32_t* output)
+{
+	const int bits = mdct->Bits;
+	const int size = 1 << bits;
+	const int half = size / 2;
+	const int32_t* window = FixedWindow[bits - 7];
+	const int32_t* shuffle = FixedShuffleTables[bits - 7];
+	int32_t* previous = mdct->ImdctPrevious;
+	int32_t dctTemp[MAX_FRAME_SAMPLES];
+
+	const int shift = HeadroomShift(input, size, bits);
+	Dct4Fixed(bits, shift, input, dctTemp);
+
+	for (int i = 0; i < half; i++)
+	{
+		output[i] = Saturate32(Windowed(window[i], dctTemp[shuffle[i + half]], shift) + previous[i]);
+		output[i + half] = Saturate32(Windowed(window[i + half], -(int64_t)dctTemp[shuffle[size - 1 - i]], shift) - previous[i + half]);
+		previous[i] = Saturate32(Windowed(window[size - 1 - i], -(int64_t)dctTemp[shuffle[half - i - 1]], shift));
+		previous[i + half] = Saturate32(Windowed(window[half - i - 1], dctTemp[shuffle[i]], shift));
+	}
+}
@@ -0,0 +1,214 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ldacdec.h"
+#include "utility.h"
+#include "spectrum.h"
+#include "pipeline.h"
+#include "bench.h"
+
+/*
+ * Times the synthesis of the float and the fixed point chain, dequantization,
+ * IMDCT and int16 conversion, on the same parsed frames and reports how far
+ * the fixed point output is off. Bitstream parsing is done up front, it is
+ * the same for both.
+ */
+
+typedef struct {
+    ldacdec_t dec;
+    MdctFixed mdctFixed[2];
+    int32_t spectraFixed[MAX_FRAME_SAMPLES];
+    int32_t pcmFixed[2][MAX_FRAME_SAMPLES];
+} bench_t;
+
+static void benchInit( bench_t *this )
+{
+    memset( this, 0, sizeof(*this) );
+    ldacdecInit( &this->dec );
+}
+
+// sets up the channel of the block like synthesizeFrame() does
+static channel_t *loadChannel( bench_t *this, const parsed_frame_t *parsed, int block, int ch )
+{
+    frame_t *frame = &this->dec.frame;
+    frame->frameSamplesPower = parsed->sampleRateId < 2 ? 7 : 8;
+    frame->frameSamples = 1 << frame->frameSamplesPower;
+    frame->channelCount = parsed->channelConfigId == 0 ? 1 : 2;
+    frame->quantizationUnitCount = parsed->quantizationUnitCount[block];
+
+    channel_t *channel = &frame->channels[ch];
+    const parsed_channel_t *in = &parsed->channels[block][ch];
+    const int active = activeSpectrumSize( frame->quantizationUnitCount );
+    memcpy( channel->scaleFactors, in->scaleFactors, sizeof(in->scaleFactors) );
+    memcpy( channel->precisions, in->precisions, sizeof(in->precisions) );
+    memcpy( channel->precisionsFine, in->precisionsFine, sizeof(in->precisionsFine) );
+    memcpy( channel->quantizedSpectra, in->quantizedSpectra, active * sizeof(int) );
+    memcpy( channel->quantizedSpectraFine, in->quantizedSpectraFine, active * sizeof(int) );
+    channel->mdct.Bits = frame->frameSamplesPower;
+    this->mdctFixed[ch].Bits = frame->frameSamplesPower;
+    return channel;
+}
+
+static int synthesizeFloat( bench_t *this, const parsed_frame_t *parsed, int16_t *pcm, float *pcmFloat )
+{
+    const frame_t *frame = &this->dec.frame;
+    for( int block = 0; block<parsed->blockCount; ++block )
+    {
+        for( int ch = 0; ch<( parsed->channelConfigId == 0 ? 1 : 2 ); ++ch )
+        {
+            channel_t *channel = loadChannel( this, parsed, block, ch );
+            dequantizeSpectra( channel );
+            RunImdct( &channel->mdct, channel->spectra, channel->pcm );
+        }
+    }
+
+    int i = 0;
+    for( int smpl = 0; smpl<frame->frameSamples; ++smpl )
+    {
+        for( int ch = 0; ch<frame->channelCount; ++ch, ++i )
+        {
+            pcm[i] = Clamp16( Round( frame->channels[ch].pcm[smpl] ) );
+            if( pcmFloat != NULL )
+                pcmFloat[i] = frame->channels[ch].pcm[smpl];
+        }
+    }
+    return i;
+}
+
+static int synthesizeFixed( bench_t *this, const parsed_frame_t *parsed, int16_t *pcm, float *pcmFloat )
+{
+    const frame_t *frame = &this->dec.frame;
+    for( int block = 0; block<parsed->blockCount; ++block )
+    {
+        for( int ch = 0; ch<( parsed->channelConfigId == 0 ? 1 : 2 ); ++ch )
+        {
+            const channel_t *channel = loadChannel( this, parsed, block, ch );
+            dequantizeSpectraFixed( channel, this->spectraFixed );
+            RunImdctFixed( &this->mdctFixed[ch], this->spectraFixed, this->pcmFixed[ch] );
+        }
+    }
+
+    int i = 0;
+    for( int smpl = 0; smpl<frame->frameSamples; ++smpl )
+    {
+        for( int ch = 0; ch<frame->channelCount; ++ch, ++i )
+        {
+            const int32_t value = this->pcmFixed[ch][smpl];
+            pcm[i] = Clamp16( ( (int64_t)value + ( 1 << ( FIXED_FRAC_BITS - 1 ) ) ) >> FIXED_FRAC_BITS );
+            if( pcmFloat != NULL )
+                pcmFloat[i] = value * ( 1.0f / ( 1 << FIXED_FRAC_BITS ) );
+        }
+    }
+    return i;
+}
+
+typedef int (*synthesize_t)( bench_t *, const parsed_frame_t *, int16_t *, float * );
+
+// ns per frame, best of runs
+static double timeChain( synthesize_t synthesize, const parsed_frame_t *frames, int frameCount, int runs )
+{
+    static bench_t bench;
+    int16_t pcm[2 * MAX_FRAME_SAMPLES];
+    double best = 0;
+    for( int run = 0; run<runs; ++run )
+    {
+        benchInit( &bench );
+        const double start = now();
+        for( int i = 0; i<frameCount; ++i )
+            synthesize( &bench, &frames[i], pcm, NULL );
+        const double elapsed = now() - start;
+        if( run == 0 || elapsed < best )
+            best = elapsed;
+    }
+    return best * 1e9 / frameCount;
+}
+
+int main( int argc, char *args[] )
+{
+    if( argc < 2 )
+    {
+        printf("usage:\n\t%s <input> <runs, optional>\n", args[0] );
+        return EXIT_SUCCESS;
+    }
+    const int runs = argc > 2 ? atoi( args[2] ) : 10;
+
+    FILE *in = fopen( args[1], "rb" );
+    if( in == NULL )
+    {
+        perror("can't open stream file");
+        return EXIT_FAILURE;
+    }
+    fseek( in, 0, SEEK_END );
+    const long length = ftell( in );
+    fseek( in, 0, SEEK_SET );
+    uint8_t *stream = malloc( length > 0 ? length : 1 );
+    if( stream == NULL || fread( stream, 1, length, in ) != (size_t)length )
+    {
+        printf("can't read \"%s\"\n", args[1] );
+        return EXIT_FAILURE;
+    }
+    fclose( in );
+
+    // the frames to synthesize, parsed once
+    parsed_frame_t *frames = NULL;
+    ldacdec_t parser;
+    ldacdecInit( &parser );
+    int frameCount = 0;
+    for( int64_t position = 0; ( position = ldacdecFindFrame( stream, length, position, NULL ) ) >= 0; )
+    {
+        if( ( frameCount & ( frameCount - 1 ) ) == 0 )
+        {
+            frames = realloc( frames, ( frameCount ? frameCount * 2 : 64 ) * sizeof(*frames) );
+            if( frames == NULL )
+                return EXIT_FAILURE;
+        }
+        if( parseFrame( &parser, stream + position, length - position, &frames[frameCount] ) < 0 )
+        {
+            position++;
+            continue;
+        }
+        position += frames[frameCount++].frameBytes;
+    }
+    free( stream );
+    if( frameCount == 0 )
+    {
+        printf("no LDAC frames found\n");
+        return EXIT_FAILURE;
+    }
+
+    // the difference, over one pass of both chains from a clean state
+    static bench_t floatBench, fixedBench;
+    benchInit( &floatBench );
+    benchInit( &fixedBench );
+    int maxDiff = 0;
+    double maxError = 0;
+    for( int i = 0; i<frameCount; ++i )
+    {
+        int16_t pcmFloat[2 * MAX_FRAME_SAMPLES], pcmFixed[2 * MAX_FRAME_SAMPLES];
+        float valueFloat[2 * MAX_FRAME_SAMPLES], valueFixed[2 * MAX_FRAME_SAMPLES];
+        const int count = synthesizeFloat( &floatBench, &frames[i], pcmFloat, valueFloat );
+        synthesizeFixed( &fixedBench, &frames[i], pcmFixed, valueFixed );
+        for( int k = 0; k<count; ++k )
+        {
+            const int diff = abs( pcmFloat[k] - pcmFixed[k] );
+            maxDiff = diff > maxDiff ? diff : maxDiff;
+            // clipped samples do not count
+            if( valueFloat[k] < -32768.0f || valueFloat[k] > 32767.0f )
+                continue;
+            const double error = valueFloat[k] > valueFixed[k] ? valueFloat[k] - valueFixed[k] : valueFixed[k] - valueFloat[k];
+            maxError = error > maxError ? error : maxError;
+        }
+    }
+
+    const double floatTime = timeChain( synthesizeFloat, frames, frameCount, runs );
+    const double fixedTime = timeChain( synthesizeFixed, frames, frameCount, runs );
+    printf("%d frames, best of %d runs\n", frameCount, runs );
+    printf("float:       %8.1f ns/frame\n", floatTime );
+    printf("fixed point: %8.1f ns/frame (%.2fx)\n", fixedTime, floatTime / fixedTime );
+    printf("max int16 difference: %d, max error %.3f LSB\n", maxDiff, maxError );
+
+    free( frames );
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "ldacdec.h"
+
+/*
+ * Header only scanner. A frame announces its own size, so walking a stream
+ * costs one 3 byte header per frame. Between frames that do not chain, the
+ * scanner resynchronises on the next sync word whose frame is followed by
+ * another valid header within a few bytes, or ends the stream exactly.
+ */
+
+#define INDEX_MAGIC         "LDIX"
+#define INDEX_VERSION       (1)
+// frames the scanner prefetches ahead
+#define INDEX_PREFETCH_FRAMES   (16)
+
+// a header only looks at 3 bytes, what is left beyond INT32_MAX does not matter
+static int peekAt( const uint8_t *stream, int64_t length, int64_t position, ldacdec_header_t *header )
+{
+    const int64_t left = length - position;
+    return ldacdecPeekHeader( stream + position, left < INT32_MAX ? (int)left : INT32_MAX, header );
+}
+
+static int frameAt( const uint8_t *stream, int64_t length, int64_t position, ldacdec_header_t *header )
+{
+    return peekAt( stream, length, position, header ) == 0 && header->frameBytes <= length - position;
+}
+
+static int chainsAt( const uint8_t *stream, int64_t length, int64_t position, ldacdec_header_t *header )
+{
+    if( !frameAt( stream, length, position, header ) )
+        return 0;
+
+    ldacdec_header_t next;
+    const int64_t end = position + header->frameBytes;
+    for( int64_t gap = end; gap <= end + LDACDEC_SYNC_SLACK; ++gap )
+    {
+        // a truncated last frame still confirms
+        if( gap == length || peekAt( stream, length, gap, &next ) != -1 )
+            return 1;
+    }
+    return 0;
+}
+
+// first frame after position that chains, -1 if there is none
+static int64_t scanFrame( const uint8_t *stream, int64_t length, int64_t position, ldacdec_header_t *header )
+{
+    for( int64_t q = position + 1; q < length; ++q )
+    {
+        const uint8_t *sync = memchr( stream + q, 0xAA, length - q );
+        if( sync == NULL )
+            break;
+        q = sync - stream;
+        if( chainsAt( stream, length, q, header ) )
+            return q;
+    }
+    return -1;
+}
+
+// position of the first frame at or after position, -1 if there is none
+static int64_t nextFrame( const uint8_t *stream, int64_t length, int64_t position, ldacdec_header_t *header )
+{
+    if( frameAt( stream, length, position, header ) )
+        return position;
+    return scanFrame( stream, length, position, header );
+}
+
+int64_t ldacdecFindFrame( const uint8_t *stream, int64_t length, int64_t position, ldacdec_header_t *header )
+{
+    ldacdec_header_t local;
+    if( header == NULL )
+        header = &local;
+    if( position < 0 || position >= length )
+        return -1;
+    if( chainsAt( stream, length, position, header ) )
+        return position;
+    return scanFrame( stream, length, position, header );
+}
+
+static int addCheckpoint( ldacdec_index_t *index, int64_t offset, int64_t sample )
+{
+    if( ( index->checkpointCount & ( index->checkpointCount - 1 ) ) == 0 )
+    {
+        const int64_t capacity = index->checkpointCount ? index->checkpointCount * 2 : 64;
+        ldacdec_checkpoint_t *checkpoints = realloc( index->checkpoints, capacity * sizeof(*checkpoints) );
+        if( checkpoints == NULL )
+            return -1;
+        index->checkpoints = checkpoints;
+    }
+    index->checkpoints[index->checkpointCount++] = (ldacdec_checkpoint_t){ offset, sample };
+    return 0;
+}
+
+int ldacdecIndexBuild( ldacdec_index_t *index, const uint8_t *stream, int64_t length, int interval )
+{
+    memset( index, 0, sizeof(*index) );
+    if( interval < 1 )
+        return -1;
+    index->interval = interval;
+
+    int64_t position = 0;
+    ldacdec_header_t header;
+    for(;;)
+    {
+        const int64_t frame = nextFrame( stream, length, position, &header );
+        if( frame < 0 )
+            break;
+        index->skippedBytes += frame - position;
+
+        if( index->frameCount == 0 )
+        {
+            index->sampleRate = header.sampleRate;
+            index->channelCount = header.channelCount;
+        }
+        if( index->frameCount % interval == 0 && addCheckpoint( index, frame, index->sampleCount ) < 0 )
+        {
+            ldacdecIndexFree( index );
+            return -1;
+        }
+
+        index->frameCount++;
+        index->sampleCount += header.frameSamples;
+        position = frame + header.frameBytes;
+        // each header depends on the last one, guessing constant frame sizes
+        // keeps the loads ahead of the walk
+        const int64_t ahead = position + INDEX_PREFETCH_FRAMES * header.frameBytes;
+        __builtin_prefetch( stream + ( ahead < length ? ahead : length - 1 ) );
+        index->byteCount = position;
+    }
+    return 0;
+}
+
+void ldacdecIndexFree( ldacdec_index_t *index )
+{
+    free( index->checkpoints );
+    index->checkpoints = NULL;
+    index->checkpointCount = 0;
+}
+
+int64_t ldacdecIndexFind( const ldacdec_index_t *index, const uint8_t *stream, int64_t length, int64_t sample, int64_t *frameSample )
+{
+    if( sample < 0 || sample >= index->sampleCount || index->checkpointCount == 0 )
+        return -1;
+
+    // last checkpoint at or before sample
+    int64_t low = 0;
+    int64_t high = index->checkpointCount - 1;
+    while( low < high )
+    {
+        const int64_t mid = ( low + high + 1 ) / 2;
+        if( index->checkpoints[mid].sample <= sample )
+            low = mid;
+        else
+            high = mid - 1;
+    }
+
+    int64_t position = index->checkpoints[low].offset;
+    int64_t first = index->checkpoints[low].sample;
+    ldacdec_header_t header;
+    for( int frames = 0; frames < index->interval; ++frames )
+    {
+        const int64_t frame = nextFrame( stream, length, position, &header );
+        if( frame < 0 )
+            break;
+        if( sample < first + header.frameSamples )
+        {
+            if( frameSample != NULL )
+                *frameSample = first;
+            return frame;
+        }
+        first += header.frameSamples;
+        position = frame + header.frameBytes;
+    }
+    // stream and index do not match
+    return -1;
+}
+
+static void put64( uint8_t *p, uint64_t value )
+{
+    for( int i=0; i<8; ++i )
+        p[i] = value >> ( 8 * i );
+}
+
+static uint64_t get64( const uint8_t *p )
+{
+    uint64_t value = 0;
+    for( int i=7; i>=0; --i )
+        value = value << 8 | p[i];
+    return value;
+}
+
+// little endian: magic, version, sample rate, channels, interval, the five
+// counts, then offset and sample of every checkpoint, all 8 bytes wide
+int ldacdecIndexSave( const ldacdec_index_t *index, FILE *out )
+{
+    uint8_t head[4 + 9 * 8];
+    memcpy( head, INDEX_MAGIC, 4 );
+    const int64_t fields[9] = {
+        INDEX_VERSION, index->sampleRate, index->channelCount, index->interval,
+        index->frameCount, index->sampleCount, index->byteCount, index->skippedBytes,
+        index->checkpointCount,
+    };
+    for( int i=0; i<9; ++i )
+        put64( head + 4 + i * 8, fields[i] );
+    if( fwrite( head, sizeof(head), 1, out ) != 1 )
+        return -1;
+
+    for( int64_t i=0; i<index->checkpointCount; ++i )
+    {
+        uint8_t entry[16];
+        put64( entry, index->checkpoints[i].offset );
+        put64( entry + 8, index->checkpoints[i].sample );
+        if( fwrite( entry, sizeof(entry), 1, out ) != 1 )
+            return -1;
+    }
+    return 0;
+}
+
+int ldacdecIndexLoad( ldacdec_index_t *index, FILE *in )
+{
+    memset( index, 0, sizeof(*index) );
+
+    uint8_t head[4 + 9 * 8];
+    if( fread( head, sizeof(head), 1, in ) != 1 || memcmp( head, INDEX_MAGIC, 4 ) != 0 )
+        return -1;
+    int64_t fields[9];
+    for( int i=0; i<9; ++i )
+        fields[i] = get64( head + 4 + i * 8 );
+    if( fields[0] != INDEX_VERSION || fields[1] < 0 || fields[1] > INT_MAX || fields[2] < 0 || fields[2] > 2 ||
+        fields[3] < 1 || fields[3] > INT_MAX || fields[4] < 0 || fields[5] < 0 || fields[6] < 0 || fields[7] < 0 )
+        return -1;
+    // one checkpoint per started interval, as ldacdecIndexBuild() adds them
+    if( fields[8] != fields[4] / fields[3] + ( fields[4] % fields[3] != 0 ) || fields[8] > INT64_MAX / 16 )
+        return -1;
+
+    index->sampleRate = fields[1];
+    index->channelCount = fields[2];
+    index->interval = fields[3];
+    index->frameCount = fields[4];
+    index->sampleCount = fields[5];
+    index->byteCount = fields[6];
+    index->skippedBytes = fields[7];
+
+    const int64_t count = fields[8];
+    if( count > 0 )
+    {
+        index->checkpoints = malloc( count * sizeof(*index->checkpoints) );
+        if( index->checkpoints == NULL )
+            return -1;
+    }
+    for( int64_t i=0; i<count; ++i )
+    {
+        uint8_t entry[16];
+        if( fread( entry, sizeof(entry), 1, in ) != 1 )
+        {
+            ldacdecIndexFree( index );
+            return -1;
+        }
+        ldacdec_checkpoint_t *checkpoint = &index->checkpoints[i];
+        checkpoint->offset = get64( entry );
+        checkpoint->sample = get64( entry + 8 );
+        // every checkpoint starts a frame of its own, after the one before
+        const ldacdec_checkpoint_t previous = i > 0 ? checkpoint[-1] : (ldacdec_checkpoint_t){ -1, -1 };
+        if( checkpoint->offset <= previous.offset || checkpoint->offset >= index->byteCount ||
+            checkpoint->sample <= previous.sample || checkpoint->sample >= index->sampleCount ||
+            ( i == 0 && checkpoint->sample != 0 ) )
+        {
+            ldacdecIndexFree( index );
+            return -1;
+        }
+    }
+    index->checkpointCount = count;
+    return 0;
+}
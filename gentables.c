@@ -0,0 +1,66 @@
+/*
+ * Build time table generator, run on the build host. It writes the IMDCT,
+ * Huffman and fixed point IMDCT tables as const data so the decoder needs no
+ * run time setup:
+ *
+ *   gentables imdct   > imdctTables.h
+ *   gentables huffman > huffTables.h
+ *   gentables fixed   > fixedTables.h
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "gentables.h"
+
+static void WriteValues(FILE* out, int count, int perLine, void (*write)(FILE*, int, void*), void* values)
+{
+	fprintf(out, "{");
+	for (int i = 0; i < count; i++)
+	{
+		fprintf(out, i % perLine ? " " : "\n\t");
+		write(out, i, values);
+		fprintf(out, ",");
+	}
+	fprintf(out, "\n}");
+}
+
+static void WriteDouble(FILE* out, int i, void* values) { fprintf(out, "%.17g", ((const double*)values)[i]); }
+static void WriteInt(FILE* out, int i, void* values) { fprintf(out, "%d", ((const int*)values)[i]); }
+static void WriteByte(FILE* out, int i, void* values) { fprintf(out, "%d", ((const uint8_t*)values)[i]); }
+
+void WriteDoubles(FILE* out, const double* values, int count)
+{
+	WriteValues(out, count, 4, WriteDouble, (void*)values);
+}
+
+void WriteInts(FILE* out, const int* values, int count)
+{
+	WriteValues(out, count, 16, WriteInt, (void*)values);
+}
+
+void WriteBytes(FILE* out, const uint8_t* values, int count)
+{
+	WriteValues(out, count, 16, WriteByte, (void*)values);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 2 && strcmp(argv[1], "imdct") == 0)
+	{
+		WriteMdctTables(stdout);
+	}
+	else if (argc == 2 && strcmp(argv[1], "huffman") == 0)
+	{
+		WriteHuffmanTables(stdout);
+	}
+	else if (argc == 2 && strcmp(argv[1], "fixed") == 0)
+	{
+		WriteFixedTables(stdout);
+	}
+	else
+	{
+		fprintf(stderr, "usage: %s imdct|huffman|fixed\n", argv[0]);
+		return 1;
+	}
+	return ferror(stdout) ? 1 : 0;
+}
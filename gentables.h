@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Helpers of the build time table generator. Values are written with enough
+ * digits to read back as the same double, the compiler then rounds them to the
+ * table's type exactly as an assignment at run time would.
+ */
+
+void WriteDoubles(FILE* out, const double* values, int count);
+void WriteInts(FILE* out, const int* values, int count);
+void WriteBytes(FILE* out, const uint8_t* values, int count);
+
+void WriteMdctTables(FILE* out);
+void WriteHuffmanTables(FILE* out);
+void WriteFixedTables(FILE* out);
@@ -2,14 +2,9 @@
 #include "utility.h"
 #include <stdint.h>
 
-int ReadHuffmanValue(const HuffmanCodebook* huff, BitReaderCxt* br, int isSigned)
-{
-	const int code = PeekInt(br, huff->MaxBitSize);
-	const unsigned char value = huff->Lookup[code];
-	const int bits = huff->Bits[value];
-	br->Position += bits;
-	return isSigned ? SignExtend32(value, huff->ValueBits) : value;
-}
+#ifdef GENERATE_TABLES
+#include "gentables.h"
+#endif
 
 void DecodeHuffmanValues(int* spectrum, int index, int bandCount, const HuffmanCodebook* huff, const int* values)
 {
@@ -27,29 +22,6 @@ void DecodeHuffmanValues(int* spectrum, int index, int bandCount, const HuffmanC
 	}
 }
 
-void InitHuffmanCodebook(const HuffmanCodebook* codebook)
-{
-	const int huffLength = codebook->Length;
-	if (huffLength == 0) return;
-
-	unsigned char* dest = codebook->Lookup;
-
-	for (int i = 0; i < huffLength; i++)
-	{
-		if (codebook->Bits[i] == 0) continue;
-		const int unusedBits = codebook->MaxBitSize - codebook->Bits[i];
-
-		const int start = codebook->Codes[i] << unusedBits;
-		const int length = 1 << unusedBits;
-		const int end = start + length;
-
-		for (int j = start; j < end; j++)
-		{
-			dest[j] = i;
-		}
-	}
-}
-
 static const uint8_t ScaleFactorsA3Bits[8] =
 {
 	2, 2, 4, 6, 6, 5, 3, 2
@@ -140,47 +112,73 @@ static const uint16_t ScaleFactorsB5Codes[32] =
 	0x62, 0x61, 0x63, 0x64, 0x6F, 0x6D, 0x6C, 0x6B, 0x6A, 0x68, 0x69, 0x45, 0x44, 0x37, 0x1A, 0x07
 };
 
-static uint8_t ScaleFactorsA3Lookup[64];
-static uint8_t ScaleFactorsA4Lookup[256];
-static uint8_t ScaleFactorsA5Lookup[256];
-static uint8_t ScaleFactorsA6Lookup[256];
+#ifndef GENERATE_TABLES
+// ScaleFactorsUnsignedLookup and ScaleFactorsSignedLookup, written by gentables
+#include "huffTables.h"
+#else
+static uint8_t ScaleFactorsUnsignedLookup[7][256];
+static uint8_t ScaleFactorsSignedLookup[6][256];
+#endif
 
-static uint8_t ScaleFactorsB2Lookup[4];
-static uint8_t ScaleFactorsB3Lookup[64];
-static uint8_t ScaleFactorsB4Lookup[256];
-static uint8_t ScaleFactorsB5Lookup[256];
-
-HuffmanCodebook HuffmanScaleFactorsUnsigned[7] = {
+const HuffmanCodebook HuffmanScaleFactorsUnsigned[7] = {
 	{0},
     {0},
     {0},
-    {ScaleFactorsA3Bits, ScaleFactorsA3Codes, ScaleFactorsA3Lookup,  8, 1, 0, 3,  8, 6},
-	{ScaleFactorsA4Bits, ScaleFactorsA4Codes, ScaleFactorsA4Lookup, 16, 1, 0, 4, 16, 8},
-	{ScaleFactorsA5Bits, ScaleFactorsA5Codes, ScaleFactorsA5Lookup, 32, 1, 0, 5, 32, 8},
-	{ScaleFactorsA6Bits, ScaleFactorsA6Codes, ScaleFactorsA6Lookup, 64, 1, 0, 6, 64, 8},
+    {ScaleFactorsA3Bits, ScaleFactorsA3Codes, ScaleFactorsUnsignedLookup[3],  8, 1, 0, 3,  8, 6},
+	{ScaleFactorsA4Bits, ScaleFactorsA4Codes, ScaleFactorsUnsignedLookup[4], 16, 1, 0, 4, 16, 8},
+	{ScaleFactorsA5Bits, ScaleFactorsA5Codes, ScaleFactorsUnsignedLookup[5], 32, 1, 0, 5, 32, 8},
+	{ScaleFactorsA6Bits, ScaleFactorsA6Codes, ScaleFactorsUnsignedLookup[6], 64, 1, 0, 6, 64, 8},
 };
 
-HuffmanCodebook HuffmanScaleFactorsSigned[6] = {
+const HuffmanCodebook HuffmanScaleFactorsSigned[6] = {
 	{0},
 	{0},
-	{ScaleFactorsB2Bits, ScaleFactorsB2Codes, ScaleFactorsB2Lookup,  4, 1, 0, 2,  4, 2},
-	{ScaleFactorsB3Bits, ScaleFactorsB3Codes, ScaleFactorsB3Lookup,  8, 1, 0, 3,  8, 6},
-	{ScaleFactorsB4Bits, ScaleFactorsB4Codes, ScaleFactorsB4Lookup, 16, 1, 0, 4, 16, 8},
-	{ScaleFactorsB5Bits, ScaleFactorsB5Codes, ScaleFactorsB5Lookup, 32, 1, 0, 5, 32, 8},
+	{ScaleFactorsB2Bits, ScaleFactorsB2Codes, ScaleFactorsSignedLookup[2],  4, 1, 0, 2,  4, 2},
+	{ScaleFactorsB3Bits, ScaleFactorsB3Codes, ScaleFactorsSignedLookup[3],  8, 1, 0, 3,  8, 6},
+	{ScaleFactorsB4Bits, ScaleFactorsB4Codes, ScaleFactorsSignedLookup[4], 16, 1, 0, 4, 16, 8},
+	{ScaleFactorsB5Bits, ScaleFactorsB5Codes, ScaleFactorsSignedLookup[5], 32, 1, 0, 5, 32, 8},
 };
 
-static void InitHuffmanSet(const HuffmanCodebook* codebooks, int count)
+#ifdef GENERATE_TABLES
+
+static void GenerateHuffmanLookup(const HuffmanCodebook* codebook, uint8_t* dest)
 {
-	for (int i = 0; i < count; i++)
+	const int huffLength = codebook->Length;
+	if (huffLength == 0) return;
+
+	for (int i = 0; i < huffLength; i++)
 	{
-		InitHuffmanCodebook(&codebooks[i]);
+		if (codebook->Bits[i] == 0) continue;
+		const int unusedBits = codebook->MaxBitSize - codebook->Bits[i];
+
+		const int start = codebook->Codes[i] << unusedBits;
+		const int length = 1 << unusedBits;
+		const int end = start + length;
+
+		for (int j = start; j < end; j++)
+		{
+			dest[j] = i;
+		}
 	}
 }
 
-void InitHuffmanCodebooks()
+static void WriteHuffmanSet(FILE* out, const char* name, const HuffmanCodebook* codebooks, uint8_t (*lookup)[256], int count)
 {
-	InitHuffmanSet(HuffmanScaleFactorsUnsigned, sizeof(HuffmanScaleFactorsUnsigned) / sizeof(HuffmanCodebook));
-	InitHuffmanSet(HuffmanScaleFactorsSigned, sizeof(HuffmanScaleFactorsSigned) / sizeof(HuffmanCodebook));
+	fprintf(out, "\nstatic const uint8_t %s[%d][256] = {\n", name, count);
+	for (int i = 0; i < count; i++)
+	{
+		GenerateHuffmanLookup(&codebooks[i], lookup[i]);
+		WriteBytes(out, lookup[i], 256);
+		fprintf(out, ",\n");
+	}
+	fprintf(out, "};\n");
 }
 
+void WriteHuffmanTables(FILE* out)
+{
+	fprintf(out, "/* generated by gentables, do not edit */\n");
+	WriteHuffmanSet(out, "ScaleFactorsUnsignedLookup", HuffmanScaleFactorsUnsigned, ScaleFactorsUnsignedLookup, 7);
+	WriteHuffmanSet(out, "ScaleFactorsSignedLookup", HuffmanScaleFactorsSigned, ScaleFactorsSignedLookup, 6);
+}
 
+#endif // GENERATE_TABLES
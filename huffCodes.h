@@ -1,12 +1,13 @@
 #pragma once
 
 #include "bit_reader.h"
+#include "utility.h"
 
 typedef struct
 {
 	const unsigned char* Bits;
 	const unsigned short* Codes;
-	unsigned char* Lookup;
+	const unsigned char* Lookup;
 	const int Length;
 	const int ValueCount;
 	const int ValueCountPower;
@@ -15,13 +16,18 @@ typedef struct
 	const int MaxBitSize;
 } HuffmanCodebook;
 
-int ReadHuffmanValue(const HuffmanCodebook* huff, BitReaderCxt* br, int isSigned);
+static inline int ReadHuffmanValue(const HuffmanCodebook* huff, BitReaderCxt* br, int isSigned)
+{
+	const int code = PeekInt(br, huff->MaxBitSize);
+	const unsigned char value = huff->Lookup[code];
+	const int bits = huff->Bits[value];
+	SkipBits(br, bits);
+	return isSigned ? SignExtend32(value, huff->ValueBits) : value;
+}
+
 void DecodeHuffmanValues(int* spectrum, int index, int bandCount, const HuffmanCodebook* huff, const int* values);
-void InitHuffmanCodebook(const HuffmanCodebook* codebook);
 
-extern HuffmanCodebook HuffmanScaleFactorsUnsigned[7];
-extern HuffmanCodebook HuffmanScaleFactorsSigned[6];
+extern const HuffmanCodebook HuffmanScaleFactorsUnsigned[7];
+extern const HuffmanCodebook HuffmanScaleFactorsSigned[6];
 extern HuffmanCodebook HuffmanSpectrum[2][8][4];
 
-void InitHuffmanCodebooks();
-
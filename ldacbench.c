@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ldacdec.h"
+#include "spectrum.h"
+#include "bench.h"
+
+/*
+ * End to end decode throughput. For every sample rate, channel config and
+ * bitrate tier a corpus of frames is synthesized in memory, then decoded with
+ * ldacDecodeFrames() in passes over the whole corpus. Nothing but decoding is
+ * timed. Results go to stdout as JSON, the fastest pass of each corpus counts.
+ * Everything runs on one thread, so the real-time factor is per core and
+ * ns_per_sample is per channel sample.
+ *
+ * The frames are noise, but shaped like an encoder's: precisions are raised
+ * round robin until the quantized spectrum fills the frame, and the band
+ * count drops until they average MEAN_PRECISION, so a lower tier codes less
+ * bandwidth as well as coarser values. Louder units get the larger scale
+ * factors. A tier whose bands and precisions come out as those of the tier
+ * below it is left out.
+ */
+
+#ifndef VERSION
+#define VERSION "unknown"
+#endif
+
+#define BENCH_FRAMES        (1024)
+// passes over a corpus, at least BENCH_MIN_PASSES and BENCH_MIN_SECONDS
+#define BENCH_MIN_PASSES    (3)
+#define BENCH_MIN_SECONDS   (0.25)
+
+// the bitstream fields written here, as libldacdec.c reads them
+#define SYNC_WORD           (0xAA)
+#define BAND_OFFSET         (2)
+#define SIDE_INFO_BITS      (4 + 1 + 2 + 6 + 6 + 5 + 5 + 5)
+#define MAX_PRECISION       (15)
+// the precision the spectrum averages at least, over all its values
+#define MEAN_PRECISION      (4)
+// gradient offset, scale factors are precision plus this
+#define GRADIENT_OFFSET     (12)
+
+static const uint8_t bandUnits[17] = {
+     0,  4,  8, 10, 12, 14, 16, 18, 20, 22, 24, 25, 26, 28, 30, 32, 34,
+};
+
+static const char *channelConfigNames[] = { "mono", "dual_mono", "stereo" };
+static const int sampleRates[] = { 44100, 48000, 88200, 96000 };
+static const int bitrates[] = { 330, 660, 990 };
+
+static uint32_t nextRandom( uint32_t *state )
+{
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// bits of the quantized spectrum of one unit
+static int unitBits( int unit, int precision )
+{
+    const int width = activeSpectrumSize( unit + 1 ) - activeSpectrumSize( unit );
+    if( precision == 1 )
+        return width == 2 ? 3 : width / 4 * 7;
+    return width * ( precision + 1 );
+}
+
+// scale factors, raw for the first channel, all equal to it for the others
+static int scaleFactorBits( int units, int channels )
+{
+    return 3 + 5 * units + ( channels - 1 ) * ( 3 + units );
+}
+
+static double meanPrecision( int units, const int *precisions )
+{
+    int sum = 0;
+    for( int i=0; i<units; ++i )
+        sum += precisions[i] * ( activeSpectrumSize( i + 1 ) - activeSpectrumSize( i ) );
+    return (double)sum / activeSpectrumSize( units );
+}
+
+// precisions that fill bits per channel, 0 if they do not reach MEAN_PRECISION
+static int allocate( int units, int bits, int *precisions )
+{
+    int used = 0;
+    for( int i=0; i<units; ++i )
+    {
+        precisions[i] = 1;
+        used += unitBits( i, 1 );
+    }
+    if( used > bits )
+        return 0;
+
+    for( int raised = 1; raised; )
+    {
+        raised = 0;
+        for( int i=0; i<units; ++i )
+        {
+            if( precisions[i] == MAX_PRECISION )
+                continue;
+            const int more = unitBits( i, precisions[i] + 1 ) - unitBits( i, precisions[i] );
+            if( used + more > bits )
+                continue;
+            precisions[i]++;
+            used += more;
+            raised = 1;
+        }
+    }
+    return meanPrecision( units, precisions ) >= MEAN_PRECISION;
+}
+
+static void writeBlock( bit_writer_t *out, int bands, int channels, const int *precisions, uint32_t *random )
+{
+    const int units = bandUnits[bands];
+    putBits( out, bands - BAND_OFFSET, 4 );
+    putBits( out, 0, 1 );
+    // gradient mode 0 over a single unit with equal values: a flat offset
+    putBits( out, 0, 2 );
+    putBits( out, 0, 6 );
+    putBits( out, 0, 6 );
+    putBits( out, GRADIENT_OFFSET, 5 );
+    putBits( out, GRADIENT_OFFSET, 5 );
+    putBits( out, 0, 5 );
+
+    for( int ch=0; ch<channels; ++ch )
+    {
+        putBits( out, 1, 1 );
+        if( ch == 0 )
+        {
+            // 5 bit scale factors
+            putBits( out, 3, 2 );
+            for( int i=0; i<units; ++i )
+                putBits( out, precisions[i] + GRADIENT_OFFSET, 5 );
+        }
+        else
+        {
+            // the 1 bit code of difference 0
+            putBits( out, 0, 2 );
+            for( int i=0; i<units; ++i )
+                putBits( out, 0, 1 );
+        }
+
+        for( int i=0; i<units; ++i )
+        {
+            const int start = activeSpectrumSize( i );
+            const int width = activeSpectrumSize( i + 1 ) - start;
+            if( precisions[i] == 1 && width == 2 )
+                putBits( out, nextRandom( random ) % 8, 3 );
+            else if( precisions[i] == 1 )
+            {
+                for( int j=0; j<width/4; ++j )
+                    putBits( out, nextRandom( random ) % 81, 7 );
+            }
+            else
+            {
+                for( int j=0; j<width; ++j )
+                    putBits( out, nextRandom( random ), precisions[i] + 1 );
+            }
+        }
+    }
+    out->position = ( out->position + 7 ) & ~7;
+}
+
+// frameBytes long frames into corpus, -1 if the tier is too small for them.
+// Returns the band count, precisions receives the precision of every unit
+static int synthesize( uint8_t *corpus, int frames, int sampleRateId, int channelConfigId, int frameBytes, int *precisions )
+{
+    const int frameSamples = sampleRateId < 2 ? 128 : 256;
+    const int channels = channelConfigId == 0 ? 1 : 2;
+    const int blocks = channelConfigId == 1 ? 2 : 1;
+    const int blockBits = ( frameBytes - 3 ) / blocks * 8;
+
+    // the most bands that cover the frame and leave room for a spectrum
+    int bands = 16;
+    while( bands > 1 && ( activeSpectrumSize( bandUnits[bands] ) > frameSamples ||
+        !allocate( bandUnits[bands], ( blockBits - SIDE_INFO_BITS - scaleFactorBits( bandUnits[bands], channels ) ) / channels, precisions ) ) )
+        bands--;
+    if( bands == 1 )
+        return -1;
+
+    uint32_t random = 0x2545f491 + sampleRateId * 3 + channelConfigId;
+    memset( corpus, 0, frames * frameBytes );
+    for( int i=0; i<frames; ++i )
+    {
+        bit_writer_t out = { corpus + i * frameBytes, 0 };
+        putBits( &out, SYNC_WORD, 8 );
+        putBits( &out, sampleRateId, 3 );
+        putBits( &out, channelConfigId, 2 );
+        putBits( &out, frameBytes - 3 - 1, 9 );
+        putBits( &out, 0, 2 );
+        for( int block=0; block<blocks; ++block )
+            writeBlock( &out, bands, channels, precisions, &random );
+    }
+    return bands;
+}
+
+// seconds of the fastest pass, -1 if the corpus does not decode
+static double timeCorpus( const uint8_t *corpus, int frames, int frameBytes, int16_t *pcm )
+{
+    static ldacdec_t dec;
+    double best = -1;
+    double total = 0;
+    for( int pass=0; pass<BENCH_MIN_PASSES || total<BENCH_MIN_SECONDS; ++pass )
+    {
+        ldacdecInit( &dec );
+        int framesDone = 0;
+        const double start = now();
+        const int ret = ldacDecodeFrames( &dec, corpus, frames * frameBytes, pcm, frames, &framesDone, NULL );
+        const double elapsed = now() - start;
+        if( ret < 0 || framesDone != frames )
+            return -1;
+        total += elapsed;
+        if( best < 0 || elapsed < best )
+            best = elapsed;
+    }
+    return best;
+}
+
+int main( void )
+{
+    uint8_t *corpus = malloc( BENCH_FRAMES * LDACDEC_MAX_FRAME_BYTES );
+    int16_t *pcm = malloc( BENCH_FRAMES * MAX_FRAME_SAMPLES * 2 * sizeof(int16_t) );
+    if( corpus == NULL || pcm == NULL )
+        return EXIT_FAILURE;
+
+    printf("{\n  \"version\": \"%s\",\n  \"frames\": %d,\n  \"results\": [", VERSION, BENCH_FRAMES );
+    const char *separator = "\n";
+    for( int sampleRateId=0; sampleRateId<4; ++sampleRateId )
+    {
+        for( int channelConfigId=0; channelConfigId<3; ++channelConfigId )
+        {
+            int lastBands = 0;
+            int lastPrecisions[MAX_QUANT_UNITS];
+            for( int tier=0; tier<3; ++tier )
+            {
+                const int sampleRate = sampleRates[sampleRateId];
+                const int frameSamples = sampleRateId < 2 ? 128 : 256;
+                const int channels = channelConfigId == 0 ? 1 : 2;
+                // the frame size the bitrate allows, header included
+                int frameBytes = (int64_t)bitrates[tier] * 1000 * frameSamples / sampleRate / 8;
+                frameBytes = frameBytes < LDACDEC_MAX_FRAME_BYTES ? frameBytes : LDACDEC_MAX_FRAME_BYTES;
+
+                int precisions[MAX_QUANT_UNITS];
+                const int bands = synthesize( corpus, BENCH_FRAMES, sampleRateId, channelConfigId, frameBytes, precisions );
+                // the tier below already codes this spectrum
+                if( bands > 0 && bands == lastBands && memcmp( precisions, lastPrecisions, bandUnits[bands] * sizeof(int) ) == 0 )
+                    continue;
+                lastBands = bands;
+                memcpy( lastPrecisions, precisions, sizeof(precisions) );
+
+                const double seconds = bands < 0 ? -1 : timeCorpus( corpus, BENCH_FRAMES, frameBytes, pcm );
+                if( seconds < 0 )
+                {
+                    fprintf( stderr, "%d Hz %s %d kbps: corpus does not decode\n", sampleRate, channelConfigNames[channelConfigId], bitrates[tier] );
+                    return EXIT_FAILURE;
+                }
+
+                const double audio = (double)BENCH_FRAMES * frameSamples / sampleRate;
+                printf("%s    { \"sample_rate\": %d, \"channel_config\": \"%s\", \"bitrate_kbps\": %d, "
+                    "\"frame_bytes\": %d, \"bands\": %d, \"mean_precision\": %.2f, \"frames_per_second\": %.1f, "
+                    "\"realtime_factor\": %.2f, \"ns_per_sample\": %.3f }",
+                    separator, sampleRate, channelConfigNames[channelConfigId], bitrates[tier],
+                    frameBytes, bands, meanPrecision( bandUnits[bands], precisions ), BENCH_FRAMES / seconds,
+                    audio / seconds, seconds * 1e9 / ( (double)BENCH_FRAMES * frameSamples * channels ) );
+                separator = ",\n";
+            }
+        }
+    }
+    printf("\n  ]\n}\n");
+
+    free( corpus );
+    free( pcm );
+    return EXIT_SUCCESS;
+}
@@ -1,10 +1,15 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <assert.h>
 #include <math.h>
 #include <float.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
 #include "ldacdec.h"
@@ -13,8 +18,8 @@
 
 SNDFILE *openAudioFile( const char *fileName, int freq, int channels )
 {
-    SF_INFO sfinfo = { 
-        .samplerate = freq, 
+    SF_INFO sfinfo = {
+        .samplerate = freq,
         .channels = channels,
         .format = SF_FORMAT_WAV | SF_FORMAT_PCM_16,
     };
@@ -31,14 +36,88 @@ SNDFILE *openAudioFile( const char *fileName, int freq, int channels )
 }
 
 
-#define BUFFER_SIZE (680*2)
-#define PCM_BUFFER_SIZE (256*2)
+// read buffer when the input can't be mapped, pipes or stdin
+#define BUFFER_SIZE (1<<20)
+// enough for a frame and the header after it, which confirms the sync word
+#define LOOKAHEAD_SIZE (4*LDACDEC_MAX_FRAME_BYTES)
+// frames collected per sf_writef_short() call
+#define PCM_FRAMES (64)
+#define PCM_BUFFER_SIZE (PCM_FRAMES*MAX_FRAME_SAMPLES*2)
+
+/*
+ * The input is either mapped as a whole or streamed through one buffer.
+ * Frames are decoded in place from data[0..length), a stream keeps at least
+ * LOOKAHEAD_SIZE bytes ahead of the decode position until its end.
+ */
+typedef struct {
+    int fd;
+    const uint8_t *data;
+    int64_t length;
+    int mapped;
+    int eof;
+    uint8_t *buffer;
+} input_t;
+
+static int openInput( input_t *this, const char *fileName )
+{
+    memset( this, 0, sizeof(*this) );
+    this->fd = strcmp( fileName, "-" ) == 0 ? STDIN_FILENO : open( fileName, O_RDONLY );
+    if( this->fd < 0 )
+        return -1;
+
+    struct stat st;
+    if( fstat( this->fd, &st ) == 0 && S_ISREG( st.st_mode ) && st.st_size > 0 )
+    {
+        void *map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, this->fd, 0 );
+        if( map != MAP_FAILED )
+        {
+            madvise( map, st.st_size, MADV_SEQUENTIAL );
+            this->data = map;
+            this->length = st.st_size;
+            this->mapped = 1;
+            this->eof = 1;
+            return 0;
+        }
+    }
+
+    this->buffer = malloc( BUFFER_SIZE );
+    if( this->buffer == NULL )
+        return -1;
+    this->data = this->buffer;
+    return 0;
+}
+
+// moves data[position..length) to the front and reads behind it
+static void refillInput( input_t *this, int64_t position )
+{
+    this->length -= position;
+    memmove( this->buffer, this->buffer + position, this->length );
+    while( this->length < BUFFER_SIZE )
+    {
+        const ssize_t bytes = read( this->fd, this->buffer + this->length, BUFFER_SIZE - this->length );
+        if( bytes <= 0 )
+        {
+            this->eof = 1;
+            break;
+        }
+        this->length += bytes;
+    }
+}
+
+static void closeInput( input_t *this )
+{
+    if( this->mapped )
+        munmap( (void *)this->data, this->length );
+    free( this->buffer );
+    if( this->fd != STDIN_FILENO )
+        close( this->fd );
+}
 
 int main(int argc, char *args[] )
 {
     if( argc < 2 )
     {
-        printf("usage:\n\t%s <input> <output, optional>\n", args[0] );
+        printf("usage:\n\t%s <input, - for stdin> <output, optional>\n", args[0] );
         return EXIT_SUCCESS;
     }
     const char *inputFile = args[1];
@@ -52,63 +131,97 @@ int main(int argc, char *args[] )
     ldacdec_t dec;
     ldacdecInit( &dec );
 
-    FILE *in = fopen( inputFile, "rb" );
-    if( in == NULL )
+    input_t in;
+    if( openInput( &in, inputFile ) < 0 )
     {
         perror("can't open stream file");
         return EXIT_FAILURE;
     }
 
     SNDFILE *out = NULL;
-
-    uint8_t buf[BUFFER_SIZE];
-    uint8_t *ptr = NULL;
-    int16_t pcm[PCM_BUFFER_SIZE] = { 0 };
-    size_t filePosition = 0;
-    int blockId = 0;
-    int bytesInBuffer = 0;
+    ldacdec_header_t format = { 0 };
+
+    static int16_t pcm[PCM_BUFFER_SIZE];
+    int pcmFrames = 0;
+    int64_t position = 0;
+    int64_t frames = 0;
+    int64_t droppedFrames = 0;
+    int64_t skippedBytes = 0;
+    int status = EXIT_SUCCESS;
     while(1)
     {
-        LOG("%ld =>\n", filePosition );
-        int ret = fseek( in, filePosition, SEEK_SET );
-        if( ret < 0 )
-            break;
-        bytesInBuffer = fread( buf, 1, BUFFER_SIZE, in );
-        ptr = buf;
-        if( bytesInBuffer == 0 )
+        if( !in.eof && in.length - position <= LOOKAHEAD_SIZE )
+        {
+            refillInput( &in, position );
+            position = 0;
+        }
+        if( position >= in.length )
             break;
-#if 1
-        if(ptr[1] == 0xAA) 
+
+        // a streamed frame only counts once the header after it is buffered too
+        const int64_t limit = in.eof ? in.length : in.length - LOOKAHEAD_SIZE;
+        ldacdec_header_t header;
+        const int64_t frame = ldacdecFindFrame( in.data, in.length, position, &header );
+        if( frame < 0 || frame > limit )
         {
-            ptr++;
-            filePosition++;
+            skippedBytes += limit - position;
+            position = limit;
+            continue;
         }
-#endif        
-        LOG("sync: %02x\n", ptr[0] );
+        skippedBytes += frame - position;
+        LOG("%" PRId64 " =>\n", frame );
+
+        // a WAV file has one format
+        if( out != NULL && ( header.sampleRate != format.sampleRate || header.channelCount != format.channelCount ) )
+        {
+            droppedFrames++;
+            position = frame + header.frameBytes;
+            continue;
+        }
+
         int bytesUsed = 0;
-      
-        memset( pcm, 0, sizeof(pcm) );
-        LOG("count === %4d ===\n", blockId++ );
-        ret = ldacDecode( &dec, ptr, pcm, &bytesUsed ); 
+        LOG("count === %4" PRId64 " ===\n", frames );
+        int ret = ldacDecodeBuffer( &dec, in.data + frame, header.frameBytes, pcm + pcmFrames * header.channelCount, &bytesUsed );
         if( ret < 0 )
-            break;
-        LOG_ARRAY( pcm, "%4d, " );
+        {
+            droppedFrames++;
+            position = frame + 1;
+            continue;
+        }
         if( out == NULL )
         {
             printf("auto detect format!\n");
-            out = openAudioFile( audioFile, ldacdecGetSampleRate( &dec ), ldacdecGetChannelCount( &dec ) ); 
+            format = header;
+            out = openAudioFile( audioFile, format.sampleRate, format.channelCount );
             if( out == NULL )
-                return EXIT_FAILURE;
+            {
+                status = EXIT_FAILURE;
+                break;
+            }
         }
 
-        sf_writef_short( out, pcm, dec.frame.frameSamples );
-        filePosition += bytesUsed;
+        frames++;
+        pcmFrames += ldacdecGetOutputSamples( &dec );
+        position = frame + bytesUsed;
+        if( ( pcmFrames + MAX_FRAME_SAMPLES ) * format.channelCount > PCM_BUFFER_SIZE )
+        {
+            sf_writef_short( out, pcm, pcmFrames );
+            pcmFrames = 0;
+        }
     }
 
-    printf("done.\n");
+    closeInput( &in );
+    if( status != EXIT_SUCCESS )
+        return status;
 
+    printf("done, %" PRId64 " frames decoded, %" PRId64 " dropped, %" PRId64 " bytes skipped.\n", frames, droppedFrames, skippedBytes );
+    if( out == NULL )
+    {
+        printf("no LDAC frames found\n");
+        return EXIT_FAILURE;
+    }
+    sf_writef_short( out, pcm, pcmFrames );
     sf_close( out );
-    fclose(in);
 
     return EXIT_SUCCESS;
 }
@@ -5,7 +5,9 @@
 #define MAX_FRAME_SAMPLES   (256)
 
 #include "log.h"
+#include "dispatch.h"
 #include "imdct.h"
+#include "fixed.h"
 
 #define container_of( ptr, type, member ) ({                \
         const typeof( ((type*)0)->member ) *__mptr = (ptr); \
@@ -22,6 +24,42 @@
        __typeof__ (b) _b = (b); \
        _a > _b ? _a : _b; });
 
+#define LDACDEC_DITHER_LANES    (8)
+
+// decode stages timed by a build with PROFILE defined
+typedef enum {
+    // frame header
+    LDACDEC_STAGE_FRAME,
+    // band count and gradient of a block
+    LDACDEC_STAGE_BAND,
+    // scale factors and precisions of a channel
+    LDACDEC_STAGE_SCALE_FACTORS,
+    LDACDEC_STAGE_SPECTRUM,
+    LDACDEC_STAGE_SPECTRUM_FINE,
+    // dequantization, scaling included
+    LDACDEC_STAGE_DEQUANTIZE,
+    LDACDEC_STAGE_IMDCT,
+    // conversion of a frame to the output format
+    LDACDEC_STAGE_PCM,
+    LDACDEC_STAGE_COUNT,
+} ldacdec_stage_t;
+
+#define LDACDEC_PROFILE_BUCKETS (32)
+
+// runs of one stage, in ticks of ldacdecGetProfileTickRate()
+typedef struct {
+    uint64_t count;
+    uint64_t ticks;
+    uint64_t maxTicks;
+    // runs of [2^i, 2^(i+1)) ticks, the first bucket also holds 0 ticks and
+    // the last everything longer
+    uint64_t histogram[LDACDEC_PROFILE_BUCKETS];
+} ldacdec_stage_profile_t;
+
+typedef struct {
+    ldacdec_stage_profile_t stages[LDACDEC_STAGE_COUNT];
+} ldacdec_profile_t;
+
 typedef struct Frame frame_t;
 typedef struct Channel channel_t;
 
@@ -44,6 +82,12 @@ struct Channel {
     float spectra[MAX_FRAME_SAMPLES];
     float pcm[MAX_FRAME_SAMPLES];
     Mdct mdct;
+    // the chain in Q(FIXED_FRAC_BITS) of a FIXED_POINT build, spectra and pcm
+    // above stay unused then. Present in every build so the layout of
+    // ldacdec_t does not depend on it
+    int32_t spectraFixed[MAX_FRAME_SAMPLES];
+    int32_t pcmFixed[MAX_FRAME_SAMPLES];
+    MdctFixed mdctFixed;
 };
 
 struct Frame {
@@ -69,17 +113,295 @@ struct Frame {
 
     int channelCount;
     channel_t channels[2];
+
+    // filled by a PROFILE build only, present in every build so the layout
+    // of ldacdec_t does not depend on it
+    ldacdec_profile_t profile;
 };
 
 typedef struct {
     frame_t frame;
 
+    // samples still to drop from the output after ldacdecSeek()
+    int discardSamples;
+    // per channel, written by the last decode call
+    int outputSamples;
+    // sign noise of ldacDecodeLost()
+    uint32_t concealSeed;
+    // TPDF dither of integer output, one generator per interleaved sample
+    // modulo LDACDEC_DITHER_LANES
+    int dither;
+    uint32_t ditherState[LDACDEC_DITHER_LANES];
 } ldacdec_t;
 
 int ldacdecInit( ldacdec_t *this );
 int ldacDecode( ldacdec_t *this, uint8_t *stream, int16_t *pcm, int *bytesUsed );
+
+// the buffer ends before the frame its header announces
+#define LDACDEC_ERR_TRUNCATED   (-2)
+
+// a queue is full, retry once frames have been called back
+#define LDACDEC_ERR_BUSY        (-3)
+
+// a packet older than the last one, reordered or duplicated
+#define LDACDEC_ERR_LATE        (-4)
+
+// 3 header bytes and up to 512 bytes of frameLength
+#define LDACDEC_MAX_FRAME_BYTES (515)
+
+// what the 3 byte frame header tells without decoding the frame
+typedef struct {
+    int sampleRate;
+    int channelCount;
+    // per channel
+    int frameSamples;
+    // header included
+    int frameBytes;
+} ldacdec_header_t;
+
+// reads only the header at stream. Returns LDACDEC_ERR_TRUNCATED below 3 bytes
+// and -1 without sync word or with an unknown sample rate or channel config
+int ldacdecPeekHeader( const uint8_t *stream, int length, ldacdec_header_t *header );
+
+// bytes allowed between a frame and the next header, captures often keep the
+// A2DP media payload header in front of every frame
+#define LDACDEC_SYNC_SLACK  (4)
+
+// offset of the first frame at or after position that is complete and followed
+// by another valid header within LDACDEC_SYNC_SLACK bytes or ends exactly at
+// length, so a stray 0xAA byte is not taken for a frame. header, if not NULL,
+// receives its header. -1 if there is none
+int64_t ldacdecFindFrame( const uint8_t *stream, int64_t length, int64_t position, ldacdec_header_t *header );
+
+// frame index from headers alone, for seeking and duration. Sample counts are
+// per channel
+typedef struct {
+    int64_t offset;
+    int64_t sample;
+} ldacdec_checkpoint_t;
+
+typedef struct {
+    // of the first frame
+    int sampleRate;
+    int channelCount;
+
+    int64_t frameCount;
+    int64_t sampleCount;
+    // end of the last frame
+    int64_t byteCount;
+    // garbage between frames the scanner resynchronised over
+    int64_t skippedBytes;
+
+    // checkpoints[k] is frame k * interval
+    int interval;
+    int64_t checkpointCount;
+    ldacdec_checkpoint_t *checkpoints;
+} ldacdec_index_t;
+
+// scans stream[0..length) header by header, 0 on success
+int ldacdecIndexBuild( ldacdec_index_t *index, const uint8_t *stream, int64_t length, int interval );
+void ldacdecIndexFree( ldacdec_index_t *index );
+// byte offset of the frame holding sample and its first sample in frameSample,
+// walking at most interval headers from a checkpoint. -1 if out of range
+int64_t ldacdecIndexFind( const ldacdec_index_t *index, const uint8_t *stream, int64_t length, int64_t sample, int64_t *frameSample );
+// portable little endian file format, 0 on success. Load fails on an index
+// whose counts and checkpoints do not fit together, as a damaged file has them
+int ldacdecIndexSave( const ldacdec_index_t *index, FILE *out );
+int ldacdecIndexLoad( ldacdec_index_t *index, FILE *in );
+
+// prepares this to decode from sample on: primes the IMDCT overlap with the
+// frame before it and makes the next decode call drop the samples of its frame
+// up to sample. Decoding continues at stream + *offset. -1 if sample is out of range
+int ldacdecSeek( ldacdec_t *this, const ldacdec_index_t *index, const uint8_t *stream, int64_t length, int64_t sample, int64_t *offset );
+// samples per channel the last decode call wrote, less than a frame after ldacdecSeek()
+int ldacdecGetOutputSamples( ldacdec_t *this );
+
+// like ldacDecode(), but reads nothing beyond stream[length-1], so frames can be
+// decoded in place from ring buffers or mapped files. Returns LDACDEC_ERR_TRUNCATED
+// if the frame is incomplete and -1 if it is invalid. A frame that fails leaves
+// the decoder as the last good frame did, so trying a false sync candidate
+// does not disturb the next frame.
+int ldacDecodeBuffer( ldacdec_t *this, const uint8_t *stream, int length, int16_t *pcm, int *bytesUsed );
+
+// float output in 16 bit scale (+-32768), neither rounded nor clamped
+// interleaved: frameSamples * channelCount values
+int ldacDecodeFloat( ldacdec_t *this, uint8_t *stream, float *pcm, int *bytesUsed );
+// planar: channel ch is written to pcm + ch * stride, stride >= frameSamples
+int ldacDecodePlanar( ldacdec_t *this, uint8_t *stream, float *pcm, int stride, int *bytesUsed );
+// integer sample formats, all interleaved and in native byte order but S24_3LE
+typedef enum {
+    LDACDEC_FORMAT_S16,
+    // 3 bytes per sample, little endian
+    LDACDEC_FORMAT_S24_3LE,
+    // 24 bit in the low bytes of an int32, sign extended
+    LDACDEC_FORMAT_S24_32,
+    LDACDEC_FORMAT_S32,
+} ldacdec_format_t;
+
+// bytes of one sample of format, -1 for an unknown format
+int ldacdecGetSampleBytes( ldacdec_format_t format );
+// ldacDecodeBuffer() with output in format, frameSamples * channelCount samples.
+// Returns -1 for an unknown format without decoding
+int ldacDecodeFormat( ldacdec_t *this, const uint8_t *stream, int length, void *pcm, ldacdec_format_t format, int *bytesUsed );
+// adds TPDF dither of one LSB before the integer output of every decode call
+// is rounded, off after ldacdecInit(). The FIXED_POINT build already holds
+// 24 bit exactly and only dithers S16
+void ldacdecSetDither( ldacdec_t *this, int enable );
+
+// decodes up to maxFrames complete frames from stream[0..length) into
+// consecutive interleaved int16 blocks. pcm needs room for maxFrames *
+// frameSamples * channelCount samples, maxFrames * MAX_FRAME_SAMPLES * 2 for
+// any stream. Stops early at an incomplete frame, returns -1 if a frame could
+// not be decoded.
+int ldacDecodeFrames( ldacdec_t *this, const uint8_t *stream, int length, int16_t *pcm, int maxFrames, int *framesDone, int *bytesDone );
+
+// decodes one frame for each of count independent decoders, as ldacDecodeBuffer()
+// would one by one. Frames of the same sample rate and channel config are
+// transformed together with one SIMD lane per stream. results[i] and bytesUsed[i]
+// are those of decoders[i], either may be NULL. Returns -1 if any frame failed
+int ldacDecodeBatch( ldacdec_t **decoders, int count, const uint8_t **streams, const int *lengths, int16_t **pcm, int *bytesUsed, int *results );
+
+// optional two stage decoder, where a synthesis thread dequantizes, transforms
+// and converts frame N while the calling thread parses frame N+1
+typedef struct ldacdec_pipeline ldacdec_pipeline_t;
+
+// NULL if the synthesis thread could not be started
+ldacdec_pipeline_t *ldacdecPipelineCreate( void );
+void ldacdecPipelineDestroy( ldacdec_pipeline_t *pipeline );
+// same contract as ldacDecodeFrames(), all frames are complete on return
+int ldacDecodeFramesPipelined( ldacdec_pipeline_t *pipeline, const uint8_t *stream, int length, int16_t *pcm, int maxFrames, int *framesDone, int *bytesDone );
+int ldacdecPipelineGetSampleRate( ldacdec_pipeline_t *pipeline );
+int ldacdecPipelineGetChannelCount( ldacdec_pipeline_t *pipeline );
+
+// multi-stream engine: a fixed pool of worker threads decodes frames of many
+// independent streams. Frames of one stream are decoded and called back in
+// submission order, different streams run in parallel.
+typedef struct ldacdec_engine ldacdec_engine_t;
+
+// called on a worker thread for every submitted frame, possibly for different
+// streams at once. status is that of ldacDecodeBuffer(), pcm holds
+// frameSamples * channelCount interleaved samples and is only valid during the call
+typedef void (*ldacdec_engine_callback_t)( void *user, int stream, void *tag, int status,
+    const int16_t *pcm, int frameSamples, int channelCount );
+
+// streams are numbered 0..streams-1, NULL on invalid arguments or failure
+ldacdec_engine_t *ldacdecEngineCreate( int workers, int streams, ldacdec_engine_callback_t callback, void *user );
+// frames still queued are decoded and called back before the workers stop,
+// as with ldacdecEngineFlush()
+void ldacdecEngineDestroy( ldacdec_engine_t *engine );
+// queues a copy of one frame and returns without waiting. Returns
+// LDACDEC_ERR_BUSY if the stream already has too many frames queued
+int ldacdecEngineSubmit( ldacdec_engine_t *engine, int stream, const uint8_t *data, int length, void *tag );
+// waits until every submitted frame has been called back
+void ldacdecEngineFlush( ldacdec_engine_t *engine );
+// starts stream over, LDACDEC_ERR_BUSY while it has frames queued
+int ldacdecEngineReset( ldacdec_engine_t *engine, int stream );
+
+// push/pull decoder for byte chunks of any size, frames need not line up with
+// them. Sync is found and kept on its own, garbage between frames is skipped
+typedef struct ldacdec_stream ldacdec_stream_t;
+
+typedef struct {
+    int64_t frames;
+    // frames with a valid header that did not decode
+    int64_t droppedFrames;
+    // bytes outside of decoded frames
+    int64_t skippedBytes;
+} ldacdec_stream_stats_t;
+
+// NULL if out of memory
+ldacdec_stream_t *ldacdecStreamCreate( void );
+void ldacdecStreamDestroy( ldacdec_stream_t *stream );
+// drops buffered bytes and samples and starts over, as after create
+void ldacdecStreamReset( ldacdec_stream_t *stream );
+// decodes the frames pushed so far. In sync a frame is decoded as soon as it is
+// complete. At the start and after a damaged frame the decoder hunts for sync,
+// and a candidate is only decoded once LDACDEC_MAX_FRAME_BYTES +
+// LDACDEC_SYNC_SLACK + 3 = 522 bytes from its start are pushed, or at
+// ldacdecStreamFlush(). Returns how many bytes were taken, fewer than length
+// only once 8 decoded frames wait to be pulled
+int ldacdecPush( ldacdec_stream_t *stream, const uint8_t *bytes, int length );
+// ends the input: decodes what is buffered without waiting for bytes behind
+// it, a last frame ending exactly at the end of the data counts as confirmed.
+// Returns LDACDEC_ERR_BUSY while the frames wait to be pulled, call it again
+// after pulling. Pushing afterwards starts hunting for sync again
+int ldacdecStreamFlush( ldacdec_stream_t *stream );
+// up to maxSamples samples per channel, interleaved, all of one format.
+// Returns the samples per channel written, 0 when nothing is decoded
+int ldacdecPull( ldacdec_stream_t *stream, int16_t *pcm, int maxSamples );
+// format of what the next pull returns, or of the last decoded frame
+int ldacdecStreamGetSampleRate( ldacdec_stream_t *stream );
+int ldacdecStreamGetChannelCount( ldacdec_stream_t *stream );
+void ldacdecStreamGetStats( ldacdec_stream_t *stream, ldacdec_stream_stats_t *stats );
+
+// A2DP depacketiser: RTP header, one byte media payload header with the frame
+// count, then whole LDAC frames. Lost packets show as sequence number gaps
+typedef struct ldacdec_a2dp ldacdec_a2dp_t;
+
+// frame count in the payload header is 4 bits
+#define LDACDEC_A2DP_MAX_SAMPLES    (15 * MAX_FRAME_SAMPLES)
+
+typedef struct {
+    uint16_t sequence;
+    uint32_t timestamp;
+    uint32_t ssrc;
+    int payloadType;
+    int marker;
+    int frameCount;
+    // packets missing right before this one, and the samples per channel
+    // they held according to the timestamps
+    int lostPackets;
+    int lostSamples;
+    // per channel, decoded from this packet
+    int samples;
+} ldacdec_packet_t;
+
+typedef struct {
+    int64_t packets;
+    int64_t frames;
+    int64_t lostPackets;
+    int64_t latePackets;
+    // malformed, fragmented or with frames that did not decode
+    int64_t invalidPackets;
+} ldacdec_a2dp_stats_t;
+
+// NULL if out of memory
+ldacdec_a2dp_t *ldacdecA2dpCreate( void );
+void ldacdecA2dpDestroy( ldacdec_a2dp_t *a2dp );
+void ldacdecA2dpReset( ldacdec_a2dp_t *a2dp );
+// decodes all frames of one media packet with a single ldacDecodeFrames() call.
+// pcm holds LDACDEC_A2DP_MAX_SAMPLES samples per channel. Returns the samples
+// per channel decoded, LDACDEC_ERR_LATE for a packet behind the sequence and
+// -1 for a malformed one. info, if not NULL, receives the headers and losses
+int ldacdecA2dpDecode( ldacdec_a2dp_t *a2dp, const uint8_t *packet, int length, int16_t *pcm, ldacdec_packet_t *info );
+int ldacdecA2dpGetSampleRate( ldacdec_a2dp_t *a2dp );
+int ldacdecA2dpGetChannelCount( ldacdec_a2dp_t *a2dp );
+void ldacdecA2dpGetStats( ldacdec_a2dp_t *a2dp, ldacdec_a2dp_stats_t *stats );
+
 int ldacNullPacket( ldacdec_t *this, uint8_t *output, int *bytesUsed );
+// conceals one lost frame in place of ldacDecode(): the last decoded spectra
+// again, with random signs and 6 dB quieter on every repetition, through the
+// regular overlap-add. Writes a frame of the last format, -1 before any frame
+int ldacDecodeLost( ldacdec_t *this, int16_t *pcm );
+// ldacDecodeLost() in one of the formats of ldacDecodeFormat()
+int ldacDecodeLostFormat( ldacdec_t *this, void *pcm, ldacdec_format_t format );
 int ldacdecGetSampleRate( ldacdec_t *this );
 int ldacdecGetChannelCount( ldacdec_t *this );
 
+// per stage timings of everything this decoder did since ldacdecInit() or
+// ldacdecResetProfile(), seeks included. A stage runs once per frame, block
+// or channel as ldacdec_stage_t says. With ldacDecodeBatch() a lane gets its
+// share of the transforms it took part in. Returns -1 and a zeroed profile
+// unless the library was built with PROFILE=true
+int ldacdecGetProfile( ldacdec_t *this, ldacdec_profile_t *profile );
+void ldacdecResetProfile( ldacdec_t *this );
+// profile ticks per second, the TSC on x86 and nanoseconds elsewhere. The
+// first call measures the TSC for 10 ms
+double ldacdecGetProfileTickRate( void );
+const char *ldacdecGetStageName( ldacdec_stage_t stage );
+
+// the kernels picked for this CPU when the library was loaded: "x86-64",
+// "sse4.2" or "avx2", or "native" for a NATIVE=true build
+const char *ldacdecGetKernelVariant( void );
+
 #endif // __LDACDEC_H_
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <limits.h>
 #include <string.h>
 
 #include "ldacdec.h"
@@ -9,11 +10,15 @@
 #include "huffCodes.h"
 #include "spectrum.h"
 #include "bit_allocation.h"
+#include "pipeline.h"
+#include "pcm.h"
+#include "profile.h"
 
 #define LDAC_SYNCWORDBITS   (8)
 #define LDAC_SYNCWORD       (0xAA)
 /** Sampling Rate **/
 #define LDAC_SMPLRATEBITS   (3)
+#define LDAC_NSMPLRATES     (4)
 /** Channel **/
 #define LDAC_CHCONFIG2BITS  (2)
 enum CHANNEL {
@@ -24,6 +29,8 @@ enum CHANNEL {
 #define LDAC_FRAMELEN2BITS  (9)
 /** Frame Status **/
 #define LDAC_FRAMESTATBITS  (2)
+/** Frame Header **/
+#define LDAC_FRAMEHEADERBYTES  (3)
 
 /** Band Info **/
 #define LDAC_NBANDBITS      (4)
@@ -113,14 +120,14 @@ static const uint8_t ga_nqus_ldac[LDAC_MAXNBANDS+1] = {
 
 int ldacdecInit( ldacdec_t *this )
 {
-    InitHuffmanCodebooks();
-    InitMdct();
+    // all tables are const data generated at build time, nothing global to set up
+    memset( this, 0, sizeof( *this ) );
 
-    memset( &this->frame.channels[0].mdct, 0, sizeof( Mdct ) ); 
-    memset( &this->frame.channels[1].mdct, 0, sizeof( Mdct ) );
-    
     this->frame.channels[0].frame = &this->frame;
     this->frame.channels[1].frame = &this->frame;
+    this->concealSeed = 0x2545f491;
+    for( int i=0; i<LDACDEC_DITHER_LANES; ++i )
+        this->ditherState[i] = 0x9e3779b9 * ( i + 1 );
 
     return 0;
 }
@@ -130,6 +137,8 @@ static int decodeBand( frame_t *this, BitReaderCxt *br )
     this->nbrBands = ReadInt( br, LDAC_NBANDBITS ) + LDAC_BAND_OFFSET;
     LOG("nbrBands:        %d\n", this->nbrBands );
     ReadInt( br, LDAC_FLAGBITS ); // unused
+    if( this->nbrBands > LDAC_MAXNBANDS )
+        return -1;
 
     this->quantizationUnitCount = ga_nqus_ldac[this->nbrBands];
     return 0;
@@ -159,6 +168,8 @@ static int decodeGradient( frame_t *this, BitReaderCxt *br )
     }
     
     this->gradientBoundary = ReadInt( br, LDAC_NADJQUBITS );
+    if( this->gradientEndUnit > LDAC_MAXNQUS )
+        return -1;
     return 0;
 }
 
@@ -280,6 +291,19 @@ static void calculatePrecisions( channel_t *this )
     LOG_ARRAY_LEN( this->precisionsFine, "%3d, ", frame->quantizationUnitCount );
 }
 
+// scale factors and precisions index fixed size tables later on
+static int checkChannel( channel_t *this )
+{
+    for( int i=0; i<this->frame->quantizationUnitCount; ++i )
+    {
+        if( this->scaleFactors[i] >= (1<<LDAC_IDSFBITS) )
+            return -1;
+        if( this->precisionsFine[i] > LDAC_MAXIDWL2 )
+            return -1;
+    }
+    return 0;
+}
+
 static int decodeScaleFactor0( channel_t *this, BitReaderCxt *br )
 {
     LOG_FUNCTION();
@@ -392,16 +416,73 @@ static const char gaa_block_setting_ldac[4][4]=
     {0, 0, 0},
 };
 
-static void pcmFloatToShort( frame_t *this, int16_t *pcmOut )
+#ifdef FIXED_POINT
+static inline float pcmToFloat( const channel_t *channel, int smpl )
+{
+    return channel->pcmFixed[smpl] * ( 1.0f / ( 1 << FIXED_FRAC_BITS ) );
+}
+#else
+static inline float pcmToFloat( const channel_t *channel, int smpl )
+{
+    return channel->pcm[smpl];
+}
+#endif
+
+// samples before first were asked to be skipped by ldacdecSeek()
+static void pcmToFormat( ldacdec_t *this, void *pcmOut, ldacdec_format_t format, int first )
+{
+    frame_t *frame = &this->frame;
+    uint32_t *dither = this->dither ? this->ditherState : NULL;
+    PROFILE_START( start );
+#ifdef FIXED_POINT
+    const int32_t *channels[2] = { frame->channels[0].pcmFixed + first, frame->channels[1].pcmFixed + first };
+    pcmConvertFixed( channels, frame->channelCount, frame->frameSamples - first, pcmOut, format, dither );
+#else
+    const float *channels[2] = { frame->channels[0].pcm + first, frame->channels[1].pcm + first };
+    pcmConvert( channels, frame->channelCount, frame->frameSamples - first, pcmOut, format, dither );
+#endif
+    PROFILE_STOP( frame, LDACDEC_STAGE_PCM, start );
+}
+
+static void pcmFloatToFloat( frame_t *this, float *pcmOut, int first )
 {
+    PROFILE_START( start );
     int i=0;
-    for(int smpl=0; smpl<this->frameSamples; ++smpl )
+    for(int smpl=first; smpl<this->frameSamples; ++smpl )
     {
         for( int ch=0; ch<this->channelCount; ++ch, ++i )
         {
-            pcmOut[i] = Clamp16(Round(this->channels[ch].pcm[smpl]));
+            pcmOut[i] = pcmToFloat( &this->channels[ch], smpl );
         }
     }
+    PROFILE_STOP( this, LDACDEC_STAGE_PCM, start );
+}
+
+static void pcmFloatToPlanar( frame_t *this, float *pcmOut, int stride, int first )
+{
+    PROFILE_START( start );
+    for( int ch=0; ch<this->channelCount; ++ch )
+    {
+        for( int smpl=first; smpl<this->frameSamples; ++smpl )
+            pcmOut[ch*stride + smpl - first] = pcmToFloat( &this->channels[ch], smpl );
+    }
+    PROFILE_STOP( this, LDACDEC_STAGE_PCM, start );
+}
+
+// consumes what is left to discard of the frame just decoded, returns the
+// first sample to output
+static int takeDiscard( ldacdec_t *this )
+{
+    const int frameSamples = this->frame.frameSamples;
+    const int first = this->discardSamples < frameSamples ? this->discardSamples : frameSamples;
+    this->discardSamples -= first;
+    this->outputSamples = frameSamples - first;
+    return first;
+}
+
+int ldacdecGetOutputSamples( ldacdec_t *this )
+{
+    return this->outputSamples;
 }
 
 static const int channelConfigIdToChannelCount[] = { 1, 2, 2 };
@@ -422,6 +503,21 @@ int ldacdecGetSampleRate( ldacdec_t *this )
     return sampleRateIdToFrequency[this->frame.sampleRateId];
 }
 
+// derives the frame geometry from sampleRateId and channelConfigId
+static void setFrameFormat( frame_t *this )
+{
+    this->channelCount = channelConfigIdToChannelCount[this->channelConfigId];
+    this->frameSamplesPower = sampleRateIdToSamplesPower[this->sampleRateId];
+    this->frameSamples = 1<<this->frameSamplesPower;
+
+    this->channels[0].mdct.Bits = this->frameSamplesPower;
+    this->channels[1].mdct.Bits = this->frameSamplesPower;
+#ifdef FIXED_POINT
+    this->channels[0].mdctFixed.Bits = this->frameSamplesPower;
+    this->channels[1].mdctFixed.Bits = this->frameSamplesPower;
+#endif
+}
+
 static int decodeFrame( frame_t *this, BitReaderCxt *br )
 {
     int syncWord = ReadInt( br, LDAC_SYNCWORDBITS );
@@ -429,16 +525,15 @@ static int decodeFrame( frame_t *this, BitReaderCxt *br )
         return -1;
 
     this->sampleRateId = ReadInt( br, LDAC_SMPLRATEBITS );
+    if( this->sampleRateId >= LDAC_NSMPLRATES )
+        return -1;
     this->channelConfigId = ReadInt( br, LDAC_CHCONFIG2BITS );
+    if( this->channelConfigId > 2 )
+        return -1;
     this->frameLength = ReadInt( br, LDAC_FRAMELEN2BITS ) + 1;
     this->frameStatus = ReadInt( br, LDAC_FRAMESTATBITS );
     
-    this->channelCount = channelConfigIdToChannelCount[this->channelConfigId];
-    this->frameSamplesPower = sampleRateIdToSamplesPower[this->sampleRateId];
-    this->frameSamples = 1<<this->frameSamplesPower;
-
-    this->channels[0].mdct.Bits = this->frameSamplesPower;
-    this->channels[1].mdct.Bits = this->frameSamplesPower;
+    setFrameFormat( this );
 
     LOG("sampleRateId:    %d\n", this->sampleRateId );
     LOG("   sample rate:  %d\n", sampleRateIdToFrequency[this->sampleRateId] );
@@ -450,46 +545,518 @@ static int decodeFrame( frame_t *this, BitReaderCxt *br )
     return 0;
 }
 
-int ldacDecode( ldacdec_t *this, uint8_t *stream, int16_t *pcm, int *bytesUsed )
+// returns the size of the frame starting at stream in bytes, header included
+static int peekFrameSize( const uint8_t *stream )
+{
+    BitReaderCxt br;
+    InitBitReaderCxt( &br, stream, LDAC_FRAMEHEADERBYTES );
+
+    if( ReadInt( &br, LDAC_SYNCWORDBITS ) != LDAC_SYNCWORD )
+        return -1;
+    ReadInt( &br, LDAC_SMPLRATEBITS + LDAC_CHCONFIG2BITS );
+    return ReadInt( &br, LDAC_FRAMELEN2BITS ) + 1 + LDAC_FRAMEHEADERBYTES;
+}
+
+int ldacdecPeekHeader( const uint8_t *stream, int length, ldacdec_header_t *header )
+{
+    if( length < LDAC_FRAMEHEADERBYTES )
+        return LDACDEC_ERR_TRUNCATED;
+
+    BitReaderCxt br;
+    InitBitReaderCxt( &br, stream, LDAC_FRAMEHEADERBYTES );
+    if( ReadInt( &br, LDAC_SYNCWORDBITS ) != LDAC_SYNCWORD )
+        return -1;
+    const int sampleRateId = ReadInt( &br, LDAC_SMPLRATEBITS );
+    const int channelConfigId = ReadInt( &br, LDAC_CHCONFIG2BITS );
+    if( sampleRateId >= LDAC_NSMPLRATES || channelConfigId > 2 )
+        return -1;
+
+    header->sampleRate = sampleRateIdToFrequency[sampleRateId];
+    header->channelCount = channelConfigIdToChannelCount[channelConfigId];
+    header->frameSamples = 1 << sampleRateIdToSamplesPower[sampleRateId];
+    header->frameBytes = ReadInt( &br, LDAC_FRAMELEN2BITS ) + 1 + LDAC_FRAMEHEADERBYTES;
+    return 0;
+}
+
+// checks the frame against length, bounds br to it and decodes the header.
+// returns the frame size in bytes
+static int openFrame( frame_t *frame, BitReaderCxt *br, const uint8_t *stream, int length )
+{
+    if( length < LDAC_FRAMEHEADERBYTES )
+        return LDACDEC_ERR_TRUNCATED;
+    const int frameSize = peekFrameSize( stream );
+    if( frameSize < 0 )
+        return -1;
+    if( frameSize > length )
+        return LDACDEC_ERR_TRUNCATED;
+
+    InitBitReaderCxt( br, stream, frameSize );
+    PROFILE_START( start );
+    const int ret = decodeFrame( frame, br );
+    PROFILE_STOP( frame, LDACDEC_STAGE_FRAME, start );
+    return ret < 0 ? -1 : frameSize;
+}
+
+static int decodeBlockHeader( frame_t *frame, BitReaderCxt *br )
+{
+    PROFILE_START( start );
+    if( decodeBand( frame, br ) < 0 || decodeGradient( frame, br ) < 0 )
+        return -1;
+    calculateGradient( frame );
+    PROFILE_STOP( frame, LDACDEC_STAGE_BAND, start );
+    return 0;
+}
+
+// everything of one channel up to the quantized spectrum
+static int decodeChannel( frame_t *frame, BitReaderCxt *br, int channelNbr )
+{
+    channel_t *channel = &frame->channels[channelNbr];
+    PROFILE_START( start );
+    decodeScaleFactors( frame, br, channelNbr );
+    calculatePrecisionMask( channel ); 
+    calculatePrecisions( channel );
+    if( checkChannel( channel ) < 0 )
+        return -1;
+    PROFILE_STOP( frame, LDACDEC_STAGE_SCALE_FACTORS, start );
+
+    PROFILE_START( spectrum );
+    decodeSpectrum( channel, br );
+    PROFILE_STOP( frame, LDACDEC_STAGE_SPECTRUM, spectrum );
+    PROFILE_START( fine );
+    decodeSpectrumFine( channel, br );
+    PROFILE_STOP( frame, LDACDEC_STAGE_SPECTRUM_FINE, fine );
+    // the frame's content does not fit its own frameLength
+    if( BitReaderOverrun( br ) )
+        return -1;
+    return 0;
+}
+
+// dequantization and IMDCT of one channel of the current block
+static void synthesizeChannel( channel_t *channel )
+{
+    PROFILE_START( start );
+#ifdef FIXED_POINT
+    dequantizeSpectraFixed( channel, channel->spectraFixed );
+#else
+    dequantizeSpectra( channel );
+#endif
+    PROFILE_STOP( channel->frame, LDACDEC_STAGE_DEQUANTIZE, start );
+
+    PROFILE_START( imdct );
+#ifdef FIXED_POINT
+    RunImdctFixed( &channel->mdctFixed, channel->spectraFixed, channel->pcmFixed );
+#else
+    RunImdct( &channel->mdct, channel->spectra, channel->pcm );
+#endif
+    PROFILE_STOP( channel->frame, LDACDEC_STAGE_IMDCT, imdct );
+}
+
+int parseFrame( ldacdec_t *this, const uint8_t *stream, int length, parsed_frame_t *parsed )
 {
     BitReaderCxt brObject;
     BitReaderCxt *br = &brObject;
-    InitBitReaderCxt( br, stream );
+    frame_t *frame = &this->frame;
+
+    const int frameSize = openFrame( frame, br, stream, length );
+    if( frameSize < 0 )
+        return frameSize;
+
+    parsed->sampleRateId = frame->sampleRateId;
+    parsed->channelConfigId = frame->channelConfigId;
+    parsed->frameLength = frame->frameLength;
+    parsed->frameStatus = frame->frameStatus;
+    parsed->blockCount = gaa_block_setting_ldac[frame->channelConfigId][1];
+
+    for( int block = 0; block<parsed->blockCount; ++block )
+    {
+        if( decodeBlockHeader( frame, br ) < 0 )
+            return -1;
+        parsed->quantizationUnitCount[block] = frame->quantizationUnitCount;
+        // nothing above the last unit is dequantized
+        const int active = activeSpectrumSize( frame->quantizationUnitCount );
+
+        for( int i=0; i<frame->channelCount; ++i )
+        {
+            const channel_t *channel = &frame->channels[i];
+            parsed_channel_t *out = &parsed->channels[block][i];
+            if( decodeChannel( frame, br, i ) < 0 )
+                return -1;
+
+            memcpy( out->scaleFactors, channel->scaleFactors, sizeof(out->scaleFactors) );
+            memcpy( out->precisions, channel->precisions, sizeof(out->precisions) );
+            memcpy( out->precisionsFine, channel->precisionsFine, sizeof(out->precisionsFine) );
+            memcpy( out->quantizedSpectra, channel->quantizedSpectra, active * sizeof(int) );
+            memcpy( out->quantizedSpectraFine, channel->quantizedSpectraFine, active * sizeof(int) );
+        }
+        AlignPosition( br, 8 );
+    }
+    AlignPosition( br, frameSize*8 );
+
+    parsed->frameBytes = br->Position / 8;
+    return 0;
+}
 
+static void setParsedFormat( frame_t *frame, const parsed_frame_t *parsed )
+{
+    frame->sampleRateId = parsed->sampleRateId;
+    frame->channelConfigId = parsed->channelConfigId;
+    frame->frameLength = parsed->frameLength;
+    frame->frameStatus = parsed->frameStatus;
+    setFrameFormat( frame );
+}
+
+static void synthesizeParsed( ldacdec_t *this, const parsed_frame_t *parsed )
+{
     frame_t *frame = &this->frame;
-   
-    int ret = decodeFrame( frame, br );
-    if( ret < 0 )
-        return -1;
-   
-    for( int block = 0; block<gaa_block_setting_ldac[frame->channelConfigId][1]; ++block )
+    setParsedFormat( frame, parsed );
+
+    for( int block = 0; block<parsed->blockCount; ++block )
     {
-        decodeBand( frame, br );
-        decodeGradient( frame, br );
-        calculateGradient( frame );
-        
+        frame->quantizationUnitCount = parsed->quantizationUnitCount[block];
+        const int active = activeSpectrumSize( frame->quantizationUnitCount );
+
         for( int i=0; i<frame->channelCount; ++i )
         {
             channel_t *channel = &frame->channels[i];
-            decodeScaleFactors( frame, br, i );
-            calculatePrecisionMask( channel ); 
-            calculatePrecisions( channel );
-
-            decodeSpectrum( channel, br );
-            decodeSpectrumFine( channel, br );
-            dequantizeSpectra( channel );
-            scaleSpectrum( channel );
+            const parsed_channel_t *in = &parsed->channels[block][i];
 
-            RunImdct( &channel->mdct, channel->spectra, channel->pcm );
+            memcpy( channel->scaleFactors, in->scaleFactors, sizeof(in->scaleFactors) );
+            memcpy( channel->precisions, in->precisions, sizeof(in->precisions) );
+            memcpy( channel->precisionsFine, in->precisionsFine, sizeof(in->precisionsFine) );
+            memcpy( channel->quantizedSpectra, in->quantizedSpectra, active * sizeof(int) );
+            memcpy( channel->quantizedSpectraFine, in->quantizedSpectraFine, active * sizeof(int) );
+            synthesizeChannel( channel );
         }
-        AlignPosition( br, 8 );
+    }
+}
+
+void synthesizeFrame( ldacdec_t *this, const parsed_frame_t *parsed, int16_t *pcm )
+{
+    synthesizeParsed( this, parsed );
+    pcmToFormat( this, pcm, LDACDEC_FORMAT_S16, takeDiscard( this ) );
+}
 
-        pcmFloatToShort( frame, pcm );
+// reads nothing beyond the frame, nor beyond stream[length-1]. The whole frame
+// is parsed before any of it is synthesized, so a frame that fails to decode,
+// a false sync candidate most of the time, leaves the IMDCT overlap and the
+// format of the last good frame as they were
+static int decodeBlocks( ldacdec_t *this, const uint8_t *stream, int length, int *bytesUsed )
+{
+    frame_t *frame = &this->frame;
+    parsed_frame_t parsed;
+    const parsed_frame_t previous = {
+        .sampleRateId = frame->sampleRateId,
+        .channelConfigId = frame->channelConfigId,
+        .frameLength = frame->frameLength,
+        .frameStatus = frame->frameStatus,
+    };
+
+    // the header is set up before the frame can fail
+    const int decoded = frame->frameSamples != 0;
+
+    const int ret = parseFrame( this, stream, length, &parsed );
+    if( ret < 0 )
+    {
+        if( decoded )
+        {
+            setParsedFormat( frame, &previous );
+        }
+        else
+        {
+            // nothing decoded yet, as after ldacdecInit()
+            frame->sampleRateId = 0;
+            frame->channelConfigId = 0;
+            frame->frameLength = 0;
+            frame->frameStatus = 0;
+            frame->channelCount = 0;
+            frame->frameSamplesPower = 0;
+            frame->frameSamples = 0;
+        }
+        return ret;
     }
-    AlignPosition( br, (frame->frameLength)*8 + 24 );
+    synthesizeParsed( this, &parsed );
 
     if( bytesUsed != NULL )
-        *bytesUsed = br->Position / 8;
+        *bytesUsed = parsed.frameBytes;
+    return 0;
+}
+
+#ifdef FIXED_POINT
+// the lanes are float kernels, the fixed point chain runs one decoder at a time
+void synthesizeFrameLanes( ldacdec_t **decoders, const parsed_frame_t **parsed, int16_t **pcm, int count )
+{
+    for( int lane=0; lane<count; ++lane )
+        synthesizeFrame( decoders[lane], parsed[lane], pcm[lane] );
+}
+#else
+void synthesizeFrameLanes( ldacdec_t **decoders, const parsed_frame_t **parsed, int16_t **pcm, int count )
+{
+    float spectra[MAX_FRAME_SAMPLES * MDCT_LANES] __attribute__((aligned(32)));
+    const parsed_channel_t *channels[MDCT_LANES];
+    int quantUnitCounts[MDCT_LANES];
+    Mdct *mdcts[MDCT_LANES];
+    float *outputs[MDCT_LANES];
+
+    for( int lane=0; lane<count; ++lane )
+        setParsedFormat( &decoders[lane]->frame, parsed[lane] );
+    const frame_t *format = &decoders[0]->frame;
+
+    for( int block = 0; block<parsed[0]->blockCount; ++block )
+    {
+        for( int i=0; i<format->channelCount; ++i )
+        {
+            for( int lane=0; lane<count; ++lane )
+            {
+                channel_t *channel = &decoders[lane]->frame.channels[i];
+                channels[lane] = &parsed[lane]->channels[block][i];
+                quantUnitCounts[lane] = parsed[lane]->quantizationUnitCount[block];
+                mdcts[lane] = &channel->mdct;
+                outputs[lane] = channel->pcm;
+            }
+            PROFILE_START( start );
+            dequantizeSpectraLanes( channels, quantUnitCounts, count, format->frameSamples, spectra );
+            // ldacDecodeLost() repeats the last spectra of each channel
+            for( int lane=0; lane<count; ++lane )
+            {
+                float *last = decoders[lane]->frame.channels[i].spectra;
+                for( int k=0; k<format->frameSamples; ++k )
+                    last[k] = spectra[k*MDCT_LANES + lane];
+            }
+            PROFILE_START( imdct );
+            RunImdctLanes( mdcts, count, spectra, outputs );
+#ifdef PROFILE
+            // every lane took part in the transforms for an equal share
+            const uint64_t end = profileTicks();
+            for( int lane=0; lane<count; ++lane )
+            {
+                profileRecord( &decoders[lane]->frame.profile, LDACDEC_STAGE_DEQUANTIZE, ( imdct - start ) / count );
+                profileRecord( &decoders[lane]->frame.profile, LDACDEC_STAGE_IMDCT, ( end - imdct ) / count );
+            }
+#endif
+        }
+    }
+
+    for( int lane=0; lane<count; ++lane )
+        pcmToFormat( decoders[lane], pcm[lane], LDACDEC_FORMAT_S16, takeDiscard( decoders[lane] ) );
+}
+#endif
+
+// below this many lanes the idle ones cost more than the shared transform saves
+#define BATCH_MIN_LANES     (MDCT_LANES * 3 / 4)
+
+// sampleRateId and channelConfigId of the frame at stream as one key, -1 without a header
+static int peekFrameFormat( const uint8_t *stream, int length )
+{
+    if( length < LDAC_FRAMEHEADERBYTES )
+        return -1;
+
+    BitReaderCxt br;
+    InitBitReaderCxt( &br, stream, LDAC_FRAMEHEADERBYTES );
+    if( ReadInt( &br, LDAC_SYNCWORDBITS ) != LDAC_SYNCWORD )
+        return -1;
+    return ReadInt( &br, LDAC_SMPLRATEBITS + LDAC_CHCONFIG2BITS );
+}
+
+static int decodeLanes( ldacdec_t **decoders, const int *index, int count, const uint8_t **streams, const int *lengths, int16_t **pcm, int *bytesUsed, int *results )
+{
+    parsed_frame_t parsed[MDCT_LANES];
+    ldacdec_t *laneDecoders[MDCT_LANES];
+    const parsed_frame_t *laneParsed[MDCT_LANES];
+    int16_t *lanePcm[MDCT_LANES];
+    int lanes = 0;
+    int ret = 0;
+
+    for( int i=0; i<count; ++i )
+    {
+        const int n = index[i];
+        const int status = parseFrame( decoders[n], streams[n], lengths[n], &parsed[i] );
+        if( results != NULL )
+            results[n] = status;
+        if( bytesUsed != NULL )
+            bytesUsed[n] = status < 0 ? 0 : parsed[i].frameBytes;
+        if( status < 0 )
+        {
+            ret = -1;
+            continue;
+        }
+        laneDecoders[lanes] = decoders[n];
+        laneParsed[lanes] = &parsed[i];
+        lanePcm[lanes] = pcm[n];
+        lanes++;
+    }
+
+    if( lanes >= BATCH_MIN_LANES )
+    {
+        synthesizeFrameLanes( laneDecoders, laneParsed, lanePcm, lanes );
+    }
+    else
+    {
+        for( int lane=0; lane<lanes; ++lane )
+            synthesizeFrame( laneDecoders[lane], laneParsed[lane], lanePcm[lane] );
+    }
+    return ret;
+}
+
+int ldacDecodeBatch( ldacdec_t **decoders, int count, const uint8_t **streams, const int *lengths, int16_t **pcm, int *bytesUsed, int *results )
+{
+    const int formats = 1 << ( LDAC_SMPLRATEBITS + LDAC_CHCONFIG2BITS );
+    int ret = 0;
+
+    // frames of one format share the lanes of a transform, those without a
+    // header (-1) fail in parseFrame() like they would in ldacDecodeBuffer()
+    for( int format = -1; format<formats; ++format )
+    {
+        int index[MDCT_LANES];
+        int lanes = 0;
+        for( int n=0; n<count; ++n )
+        {
+            if( peekFrameFormat( streams[n], lengths[n] ) != format )
+                continue;
+            index[lanes++] = n;
+            if( lanes == MDCT_LANES )
+            {
+                ret |= decodeLanes( decoders, index, lanes, streams, lengths, pcm, bytesUsed, results );
+                lanes = 0;
+            }
+        }
+        if( lanes > 0 )
+            ret |= decodeLanes( decoders, index, lanes, streams, lengths, pcm, bytesUsed, results );
+    }
+    return ret < 0 ? -1 : 0;
+}
+
+int ldacDecode( ldacdec_t *this, uint8_t *stream, int16_t *pcm, int *bytesUsed )
+{
+    int ret = decodeBlocks( this, stream, INT_MAX, bytesUsed );
+    if( ret < 0 )
+        return ret;
+
+    pcmToFormat( this, pcm, LDACDEC_FORMAT_S16, takeDiscard( this ) );
+    return 0;
+}
+
+int ldacDecodeBuffer( ldacdec_t *this, const uint8_t *stream, int length, int16_t *pcm, int *bytesUsed )
+{
+    int ret = decodeBlocks( this, stream, length, bytesUsed );
+    if( ret < 0 )
+        return ret;
+
+    pcmToFormat( this, pcm, LDACDEC_FORMAT_S16, takeDiscard( this ) );
+    return 0;
+}
+
+int ldacdecGetSampleBytes( ldacdec_format_t format )
+{
+    static const int bytes[] = { 2, 3, 4, 4 };
+    if( (unsigned)format > LDACDEC_FORMAT_S32 )
+        return -1;
+    return bytes[format];
+}
+
+int ldacDecodeFormat( ldacdec_t *this, const uint8_t *stream, int length, void *pcm, ldacdec_format_t format, int *bytesUsed )
+{
+    if( (unsigned)format > LDACDEC_FORMAT_S32 )
+        return -1;
+
+    int ret = decodeBlocks( this, stream, length, bytesUsed );
+    if( ret < 0 )
+        return ret;
+
+    pcmToFormat( this, pcm, format, takeDiscard( this ) );
+    return 0;
+}
+
+void ldacdecSetDither( ldacdec_t *this, int enable )
+{
+    this->dither = enable;
+}
+
+int ldacDecodeFloat( ldacdec_t *this, uint8_t *stream, float *pcm, int *bytesUsed )
+{
+    int ret = decodeBlocks( this, stream, INT_MAX, bytesUsed );
+    if( ret < 0 )
+        return ret;
+
+    pcmFloatToFloat( &this->frame, pcm, takeDiscard( this ) );
+    return 0;
+}
+
+int ldacDecodePlanar( ldacdec_t *this, uint8_t *stream, float *pcm, int stride, int *bytesUsed )
+{
+    int ret = decodeBlocks( this, stream, INT_MAX, bytesUsed );
+    if( ret < 0 )
+        return ret;
+
+    pcmFloatToPlanar( &this->frame, pcm, stride, takeDiscard( this ) );
+    return 0;
+}
+
+int ldacDecodeFrames( ldacdec_t *this, const uint8_t *stream, int length, int16_t *pcm, int maxFrames, int *framesDone, int *bytesDone )
+{
+    frame_t *frame = &this->frame;
+    int frames = 0;
+    int position = 0;
+    int ret = 0;
+
+    while( frames < maxFrames && length - position >= LDAC_FRAMEHEADERBYTES )
+    {
+        // openFrame() reads the header once and checks the frame against
+        // what is left before anything is decoded
+        int bytesUsed = 0;
+        ret = decodeBlocks( this, stream + position, length - position, &bytesUsed );
+        // incomplete frame at the end of the buffer, leave it to the next call
+        if( ret == LDACDEC_ERR_TRUNCATED )
+        {
+            ret = 0;
+            break;
+        }
+        if( ret < 0 )
+            break;
+
+        pcmToFormat( this, pcm, LDACDEC_FORMAT_S16, takeDiscard( this ) );
+        pcm += this->outputSamples * frame->channelCount;
+        position += bytesUsed;
+        frames++;
+    }
+
+    if( framesDone != NULL )
+        *framesDone = frames;
+    if( bytesDone != NULL )
+        *bytesDone = position;
+    return ret;
+}
+
+// a clean decoder for a seek, which keeps the settings of the stream
+static void restartDecoder( ldacdec_t *this )
+{
+    const int dither = this->dither;
+    const ldacdec_profile_t profile = this->frame.profile;
+    ldacdecInit( this );
+    this->dither = dither;
+    this->frame.profile = profile;
+}
+
+int ldacdecSeek( ldacdec_t *this, const ldacdec_index_t *index, const uint8_t *stream, int64_t length, int64_t sample, int64_t *offset )
+{
+    int64_t frameSample;
+    const int64_t frame = ldacdecIndexFind( index, stream, length, sample, &frameSample );
+    if( frame < 0 )
+        return -1;
+
+    restartDecoder( this );
+    // the overlap of frame comes from the second half of the frame before it,
+    // decoding that one is enough to continue exactly as a full decode would
+    const int64_t previous = frameSample > 0 ? ldacdecIndexFind( index, stream, length, frameSample - 1, NULL ) : -1;
+    if( previous >= 0 )
+    {
+        const int64_t left = length - previous;
+        if( decodeBlocks( this, stream + previous, left < LDACDEC_MAX_FRAME_BYTES ? (int)left : LDACDEC_MAX_FRAME_BYTES, NULL ) < 0 )
+            restartDecoder( this );
+    }
+
+    this->discardSamples = sample - frameSample;
+    if( offset != NULL )
+        *offset = frame;
     return 0;
 }
 
@@ -517,4 +1084,59 @@ int ldacNullPacket( ldacdec_t *this, uint8_t *output, int *bytesUsed )
     }
 
     *bytesUsed = frame->frameLength + 3;
+    return 0;
+}
+
+// a frame is attenuated by this on each repetition
+#define PLC_FADE        (0.5f)
+
+static uint32_t nextRandom( uint32_t *state )
+{
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+int ldacDecodeLostFormat( ldacdec_t *this, void *pcm, ldacdec_format_t format )
+{
+    frame_t *frame = &this->frame;
+    if( frame->frameSamples == 0 || (unsigned)format > LDACDEC_FORMAT_S32 )
+        return -1;
+
+    for( int i=0; i<frame->channelCount; ++i )
+    {
+        channel_t *channel = &frame->channels[i];
+        // repeating the spectrum as is would ring at the frame rate, random
+        // signs keep its envelope but not its phase
+        for( int k=0; k<frame->frameSamples; k+=32 )
+        {
+            uint32_t signs = nextRandom( &this->concealSeed );
+#ifdef FIXED_POINT
+            // PLC_FADE as a shift
+            for( int j=k; j<k+32; ++j, signs >>= 1 )
+                channel->spectraFixed[j] = ( signs & 1 ) ? -( channel->spectraFixed[j] >> 1 ) : channel->spectraFixed[j] >> 1;
+#else
+            for( int j=k; j<k+32; ++j, signs >>= 1 )
+                channel->spectra[j] *= ( signs & 1 ) ? -PLC_FADE : PLC_FADE;
+#endif
+        }
+        // the overlap blends the last good frame into this one, and this one
+        // into the next good frame
+#ifdef FIXED_POINT
+        RunImdctFixed( &channel->mdctFixed, channel->spectraFixed, channel->pcmFixed );
+#else
+        RunImdct( &channel->mdct, channel->spectra, channel->pcm );
+#endif
+    }
+
+    pcmToFormat( this, pcm, format, takeDiscard( this ) );
+    return 0;
+}
+
+int ldacDecodeLost( ldacdec_t *this, int16_t *pcm )
+{
+    return ldacDecodeLostFormat( this, pcm, LDACDEC_FORMAT_S16 );
 }
@@ -0,0 +1,382 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "ldacdec.h"
+#include "pcm.h"
+
+/*
+ * Integer output of a decoded frame. Samples are scaled from 16 bit to the
+ * output width, exact as the scale is a power of two, dithered, rounded half
+ * up like Round() and saturated. The AVX2 kernel takes eight samples per
+ * channel and step: it interleaves with unpacks and a lane permute, rounds to
+ * nearest even and moves the ties up, and narrows with a saturating pack or a
+ * byte shuffle. The SSE2 kernel does the same in two halves of four samples,
+ * with the SSE4.1 clamp and the SSSE3 byte shuffle where the target has them
+ * and their SSE2 equivalents where not. Dither value i of a call comes from
+ * generator i % LDACDEC_DITHER_LANES in every version, so they all write the
+ * same bits.
+ */
+
+#define S24_MAX     (8388607)
+#define S24_MIN     (-8388608)
+
+static const float formatScale[] = { 1.0f, 256.0f, 256.0f, 65536.0f };
+static const int32_t formatMin[] = { INT16_MIN, S24_MIN, S24_MIN, INT32_MIN };
+static const int32_t formatMax[] = { INT16_MAX, S24_MAX, S24_MAX, INT32_MAX };
+// fraction bits of the 16 bit scale the format drops, negative if it adds some
+static const int formatShift[] = { 0, -8, -8, -16 };
+
+static uint32_t nextDither( uint32_t *state )
+{
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// sum of the two 16 bit halves, triangular over [0, 2^17)
+static inline int32_t ditherSum( uint32_t r )
+{
+    return ( r >> 16 ) + ( r & 0xffff );
+}
+
+static inline int32_t roundSample( float value, ldacdec_format_t format )
+{
+    const double rounded = floor( (double)value + 0.5 );
+    // NaN ends up at the minimum, as in the SIMD kernel
+    if( !( rounded >= formatMin[format] ) )
+        return formatMin[format];
+    return rounded > formatMax[format] ? formatMax[format] : (int32_t)rounded;
+}
+
+static inline void storeSample( void *out, int i, ldacdec_format_t format, int32_t value )
+{
+    switch( format )
+    {
+    case LDACDEC_FORMAT_S16:
+        ((int16_t *)out)[i] = value;
+        break;
+    case LDACDEC_FORMAT_S24_3LE:
+    {
+        uint8_t *p = (uint8_t *)out + 3 * i;
+        p[0] = value;
+        p[1] = value >> 8;
+        p[2] = value >> 16;
+        break;
+    }
+    default:
+        ((int32_t *)out)[i] = value;
+        break;
+    }
+}
+
+// samples first..count of every channel
+static void convertSamples( const float * const *channels, int channelCount, int first, int count, void *out, ldacdec_format_t format, uint32_t *ditherState )
+{
+    const float scale = formatScale[format];
+    int i = first * channelCount;
+    for( int smpl=first; smpl<count; ++smpl )
+    {
+        for( int ch=0; ch<channelCount; ++ch, ++i )
+        {
+            float value = channels[ch][smpl] * scale;
+            if( ditherState != NULL )
+                value += ditherSum( nextDither( &ditherState[i % LDACDEC_DITHER_LANES] ) ) * ( 1.0f / 65536 ) - 1.0f;
+            storeSample( out, i, format, roundSample( value, format ) );
+        }
+    }
+}
+
+void pcmConvertReference( const float * const *channels, int channelCount, int count, void *out, ldacdec_format_t format, uint32_t *ditherState )
+{
+    convertSamples( channels, channelCount, 0, count, out, format, ditherState );
+}
+
+#if defined(__AVX2__)
+
+static inline __m256 ditherVector( __m256i *state )
+{
+    __m256i x = *state;
+    x = _mm256_xor_si256( x, _mm256_slli_epi32( x, 13 ) );
+    x = _mm256_xor_si256( x, _mm256_srli_epi32( x, 17 ) );
+    x = _mm256_xor_si256( x, _mm256_slli_epi32( x, 5 ) );
+    *state = x;
+    const __m256i sum = _mm256_add_epi32( _mm256_srli_epi32( x, 16 ), _mm256_and_si256( x, _mm256_set1_epi32( 0xffff ) ) );
+    return _mm256_sub_ps( _mm256_mul_ps( _mm256_cvtepi32_ps( sum ), _mm256_set1_ps( 1.0f / 65536 ) ), _mm256_set1_ps( 1.0f ) );
+}
+
+static inline __m256i roundVector( __m256 value )
+{
+    __m256i rounded = _mm256_cvtps_epi32( value );
+    // a tie went to the even neighbour, half up wants the upper one. The
+    // difference is exact, only values below 2^23 have a fraction
+    const __m256 tie = _mm256_cmp_ps( _mm256_sub_ps( value, _mm256_cvtepi32_ps( rounded ) ), _mm256_set1_ps( 0.5f ), _CMP_EQ_OQ );
+    rounded = _mm256_sub_epi32( rounded, _mm256_castps_si256( tie ) );
+    // out of range converts to INT32_MIN, which is right for negative values
+    const __m256 high = _mm256_cmp_ps( value, _mm256_set1_ps( 2147483648.0f ), _CMP_GE_OQ );
+    return _mm256_xor_si256( rounded, _mm256_castps_si256( high ) );
+}
+
+static inline __m256i clamp24( __m256i value )
+{
+    return _mm256_max_epi32( _mm256_min_epi32( value, _mm256_set1_epi32( S24_MAX ) ), _mm256_set1_epi32( S24_MIN ) );
+}
+
+// samples i..i+7 of the interleaved output
+static inline void storeVector( void *out, int i, ldacdec_format_t format, __m256i value )
+{
+    switch( format )
+    {
+    case LDACDEC_FORMAT_S16:
+        _mm_storeu_si128( (__m128i *)( (int16_t *)out + i ),
+            _mm_packs_epi32( _mm256_castsi256_si128( value ), _mm256_extracti128_si256( value, 1 ) ) );
+        break;
+    case LDACDEC_FORMAT_S24_3LE:
+    {
+        // the low 3 bytes of each sample, 12 bytes per 128 bit lane
+        const __m256i bytes = _mm256_shuffle_epi8( clamp24( value ), _mm256_setr_epi8(
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1 ) );
+        uint8_t packed[32];
+        _mm256_storeu_si256( (__m256i *)packed, bytes );
+        memcpy( (uint8_t *)out + 3 * i, packed, 12 );
+        memcpy( (uint8_t *)out + 3 * i + 12, packed + 16, 12 );
+        break;
+    }
+    case LDACDEC_FORMAT_S24_32:
+        _mm256_storeu_si256( (__m256i *)( (int32_t *)out + i ), clamp24( value ) );
+        break;
+    default:
+        _mm256_storeu_si256( (__m256i *)( (int32_t *)out + i ), value );
+        break;
+    }
+}
+
+// whole groups of 8 samples per channel, returns the samples done. Inlined
+// once per format, so the format switches fold away
+static inline __attribute__((always_inline)) int convertVectors( const float * const *channels, int channelCount, int count, void *out, ldacdec_format_t format, uint32_t *ditherState )
+{
+    const __m256 scale = _mm256_set1_ps( formatScale[format] );
+    __m256i state = ditherState != NULL ? _mm256_loadu_si256( (const __m256i *)ditherState ) : _mm256_setzero_si256();
+    int smpl = 0;
+    int i = 0;
+    for( ; smpl + 8 <= count; smpl += 8 )
+    {
+        __m256 values[2];
+        if( channelCount == 1 )
+        {
+            values[0] = _mm256_loadu_ps( channels[0] + smpl );
+        }
+        else
+        {
+            const __m256 left = _mm256_loadu_ps( channels[0] + smpl );
+            const __m256 right = _mm256_loadu_ps( channels[1] + smpl );
+            const __m256 low = _mm256_unpacklo_ps( left, right );
+            const __m256 high = _mm256_unpackhi_ps( left, right );
+            values[0] = _mm256_permute2f128_ps( low, high, 0x20 );
+            values[1] = _mm256_permute2f128_ps( low, high, 0x31 );
+        }
+        for( int k=0; k<channelCount; ++k, i += 8 )
+        {
+            __m256 value = _mm256_mul_ps( values[k], scale );
+            if( ditherState != NULL )
+                value = _mm256_add_ps( value, ditherVector( &state ) );
+            storeVector( out, i, format, roundVector( value ) );
+        }
+    }
+    if( ditherState != NULL )
+        _mm256_storeu_si256( (__m256i *)ditherState, state );
+    return smpl;
+}
+
+#elif defined(__SSE2__)
+
+static inline __m128 ditherVector( __m128i *state )
+{
+    __m128i x = *state;
+    x = _mm_xor_si128( x, _mm_slli_epi32( x, 13 ) );
+    x = _mm_xor_si128( x, _mm_srli_epi32( x, 17 ) );
+    x = _mm_xor_si128( x, _mm_slli_epi32( x, 5 ) );
+    *state = x;
+    const __m128i sum = _mm_add_epi32( _mm_srli_epi32( x, 16 ), _mm_and_si128( x, _mm_set1_epi32( 0xffff ) ) );
+    return _mm_sub_ps( _mm_mul_ps( _mm_cvtepi32_ps( sum ), _mm_set1_ps( 1.0f / 65536 ) ), _mm_set1_ps( 1.0f ) );
+}
+
+// as the AVX2 version
+static inline __m128i roundVector( __m128 value )
+{
+    __m128i rounded = _mm_cvtps_epi32( value );
+    const __m128 tie = _mm_cmpeq_ps( _mm_sub_ps( value, _mm_cvtepi32_ps( rounded ) ), _mm_set1_ps( 0.5f ) );
+    rounded = _mm_sub_epi32( rounded, _mm_castps_si128( tie ) );
+    const __m128 high = _mm_cmpge_ps( value, _mm_set1_ps( 2147483648.0f ) );
+    return _mm_xor_si128( rounded, _mm_castps_si128( high ) );
+}
+
+static inline __m128i clamp24( __m128i value )
+{
+    const __m128i max = _mm_set1_epi32( S24_MAX );
+    const __m128i min = _mm_set1_epi32( S24_MIN );
+#if defined(__SSE4_1__)
+    return _mm_max_epi32( _mm_min_epi32( value, max ), min );
+#else
+    const __m128i above = _mm_cmpgt_epi32( value, max );
+    value = _mm_or_si128( _mm_and_si128( above, max ), _mm_andnot_si128( above, value ) );
+    const __m128i below = _mm_cmpgt_epi32( min, value );
+    return _mm_or_si128( _mm_and_si128( below, min ), _mm_andnot_si128( below, value ) );
+#endif
+}
+
+// samples i..i+7 of the interleaved output, i..i+3 in low
+static inline void storeVector( void *out, int i, ldacdec_format_t format, __m128i low, __m128i high )
+{
+    switch( format )
+    {
+    case LDACDEC_FORMAT_S16:
+        _mm_storeu_si128( (__m128i *)( (int16_t *)out + i ), _mm_packs_epi32( low, high ) );
+        break;
+    case LDACDEC_FORMAT_S24_3LE:
+    {
+#if defined(__SSSE3__)
+        // the low 3 bytes of each sample, the second store overwrites the
+        // unused tail of the first
+        const __m128i pick = _mm_setr_epi8( 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1 );
+        uint8_t packed[28];
+        _mm_storeu_si128( (__m128i *)packed, _mm_shuffle_epi8( clamp24( low ), pick ) );
+        _mm_storeu_si128( (__m128i *)( packed + 12 ), _mm_shuffle_epi8( clamp24( high ), pick ) );
+        memcpy( (uint8_t *)out + 3 * i, packed, 24 );
+#else
+        int32_t values[8];
+        _mm_storeu_si128( (__m128i *)values, clamp24( low ) );
+        _mm_storeu_si128( (__m128i *)( values + 4 ), clamp24( high ) );
+        for( int k=0; k<8; ++k )
+            storeSample( out, i + k, LDACDEC_FORMAT_S24_3LE, values[k] );
+#endif
+        break;
+    }
+    case LDACDEC_FORMAT_S24_32:
+        _mm_storeu_si128( (__m128i *)( (int32_t *)out + i ), clamp24( low ) );
+        _mm_storeu_si128( (__m128i *)( (int32_t *)out + i + 4 ), clamp24( high ) );
+        break;
+    default:
+        _mm_storeu_si128( (__m128i *)( (int32_t *)out + i ), low );
+        _mm_storeu_si128( (__m128i *)( (int32_t *)out + i + 4 ), high );
+        break;
+    }
+}
+
+// whole groups of 8 samples per channel as in the AVX2 version. Generators
+// 0..3 dither the low half of 8 output samples, 4..7 the high half
+static inline __attribute__((always_inline)) int convertVectors( const float * const *channels, int channelCount, int count, void *out, ldacdec_format_t format, uint32_t *ditherState )
+{
+    const __m128 scale = _mm_set1_ps( formatScale[format] );
+    __m128i state[2] = { _mm_setzero_si128(), _mm_setzero_si128() };
+    if( ditherState != NULL )
+    {
+        state[0] = _mm_loadu_si128( (const __m128i *)ditherState );
+        state[1] = _mm_loadu_si128( (const __m128i *)( ditherState + 4 ) );
+    }
+    int smpl = 0;
+    int i = 0;
+    for( ; smpl + 8 <= count; smpl += 8 )
+    {
+        __m128 values[4];
+        const __m128 left[2] = { _mm_loadu_ps( channels[0] + smpl ), _mm_loadu_ps( channels[0] + smpl + 4 ) };
+        if( channelCount == 1 )
+        {
+            values[0] = left[0];
+            values[1] = left[1];
+        }
+        else
+        {
+            const __m128 right[2] = { _mm_loadu_ps( channels[1] + smpl ), _mm_loadu_ps( channels[1] + smpl + 4 ) };
+            values[0] = _mm_unpacklo_ps( left[0], right[0] );
+            values[1] = _mm_unpackhi_ps( left[0], right[0] );
+            values[2] = _mm_unpacklo_ps( left[1], right[1] );
+            values[3] = _mm_unpackhi_ps( left[1], right[1] );
+        }
+        for( int k=0; k<2*channelCount; k += 2, i += 8 )
+        {
+            __m128 low = _mm_mul_ps( values[k], scale );
+            __m128 high = _mm_mul_ps( values[k + 1], scale );
+            if( ditherState != NULL )
+            {
+                low = _mm_add_ps( low, ditherVector( &state[0] ) );
+                high = _mm_add_ps( high, ditherVector( &state[1] ) );
+            }
+            storeVector( out, i, format, roundVector( low ), roundVector( high ) );
+        }
+    }
+    if( ditherState != NULL )
+    {
+        _mm_storeu_si128( (__m128i *)ditherState, state[0] );
+        _mm_storeu_si128( (__m128i *)( ditherState + 4 ), state[1] );
+    }
+    return smpl;
+}
+
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+void pcmConvert( const float * const *channels, int channelCount, int count, void *out, ldacdec_format_t format, uint32_t *ditherState )
+{
+    int done;
+    switch( format )
+    {
+    case LDACDEC_FORMAT_S16:
+        done = convertVectors( channels, channelCount, count, out, LDACDEC_FORMAT_S16, ditherState );
+        break;
+    case LDACDEC_FORMAT_S24_3LE:
+        done = convertVectors( channels, channelCount, count, out, LDACDEC_FORMAT_S24_3LE, ditherState );
+        break;
+    case LDACDEC_FORMAT_S24_32:
+        done = convertVectors( channels, channelCount, count, out, LDACDEC_FORMAT_S24_32, ditherState );
+        break;
+    default:
+        done = convertVectors( channels, channelCount, count, out, LDACDEC_FORMAT_S32, ditherState );
+        break;
+    }
+    // after a seek the frame can end off the vector grid
+    convertSamples( channels, channelCount, done, count, out, format, ditherState );
+}
+
+#else
+
+void pcmConvert( const float * const *channels, int channelCount, int count, void *out, ldacdec_format_t format, uint32_t *ditherState )
+{
+    convertSamples( channels, channelCount, 0, count, out, format, ditherState );
+}
+
+#endif
+
+void pcmConvertFixed( const int32_t * const *channels, int channelCount, int count, void *out, ldacdec_format_t format, uint32_t *ditherState )
+{
+    const int shift = FIXED_FRAC_BITS + formatShift[format];
+    int i = 0;
+    for( int smpl=0; smpl<count; ++smpl )
+    {
+        for( int ch=0; ch<channelCount; ++ch, ++i )
+        {
+            int64_t value = channels[ch][smpl];
+            if( shift > 0 )
+            {
+                if( ditherState != NULL )
+                    value += ( ditherSum( nextDither( &ditherState[i % LDACDEC_DITHER_LANES] ) ) - 65536 ) >> ( 16 - shift );
+                value = ( value + ( 1 << ( shift - 1 ) ) ) >> shift;
+            }
+            else
+            {
+                value *= (int64_t)1 << -shift;
+            }
+            value = value < formatMin[format] ? formatMin[format] : value > formatMax[format] ? formatMax[format] : value;
+            storeSample( out, i, format, value );
+        }
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef _PCM_H_
+#define _PCM_H_
+
+#include "ldacdec.h"
+
+// interleaves count samples of each of channelCount channels in 16 bit scale
+// into out as format, rounded half up and saturated. With ditherState, TPDF
+// dither of one LSB of format is added before rounding
+void pcmConvert( const float * const *channels, int channelCount, int count, void *out, ldacdec_format_t format, uint32_t *ditherState );
+// plain C version of pcmConvert(), kept as reference for the SIMD kernel
+void pcmConvertReference( const float * const *channels, int channelCount, int count, void *out, ldacdec_format_t format, uint32_t *ditherState );
+// pcmConvert() for Q(FIXED_FRAC_BITS) samples, only S16 is dithered
+void pcmConvertFixed( const int32_t * const *channels, int channelCount, int count, void *out, ldacdec_format_t format, uint32_t *ditherState );
+
+#endif // _PCM_H_
@@ -0,0 +1,210 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ldacdec.h"
+#include "pipeline.h"
+
+/*
+ * Two stage decoder: the calling thread parses frame N+1 into a ring slot
+ * while the synthesis thread dequantizes, transforms and converts frame N.
+ * The ring is single producer, single consumer: only the caller advances
+ * tail, only the synthesis thread advances head. A stage that finds nothing
+ * to do spins briefly and then sleeps on the condition variable, the other
+ * stage only takes the lock to wake it if it announced itself in sleepers.
+ */
+
+// ring slots, power of two
+#define PIPELINE_DEPTH      (4)
+// polls before a waiting stage goes to sleep, about a frame's worth of time.
+// Without a second core to run the other stage, spinning only delays it
+#define PIPELINE_SPINS      (512)
+
+typedef struct {
+    parsed_frame_t parsed;
+    int16_t *pcm;
+} pipeline_slot_t;
+
+struct ldacdec_pipeline {
+    ldacdec_t parser;
+    ldacdec_t synth;
+    pipeline_slot_t slots[PIPELINE_DEPTH];
+
+    // own cache lines, each is written by one thread only
+    _Alignas(64) atomic_uint head;
+    _Alignas(64) atomic_uint tail;
+
+    _Alignas(64) atomic_int sleepers;
+    atomic_int quit;
+    int spins;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+};
+
+static inline void cpuRelax( void )
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+static int hasWork( ldacdec_pipeline_t *this )
+{
+    return atomic_load( &this->head ) != atomic_load( &this->tail ) || atomic_load( &this->quit );
+}
+
+static int hasSpace( ldacdec_pipeline_t *this )
+{
+    return atomic_load( &this->tail ) - atomic_load( &this->head ) < PIPELINE_DEPTH;
+}
+
+static int isDrained( ldacdec_pipeline_t *this )
+{
+    return atomic_load( &this->head ) == atomic_load( &this->tail );
+}
+
+static void pipelineWait( ldacdec_pipeline_t *this, int (*ready)( ldacdec_pipeline_t * ) )
+{
+    for( int spin=0; spin<this->spins; ++spin )
+    {
+        if( ready( this ) )
+            return;
+        cpuRelax();
+    }
+
+    // sleepers is raised before ready() is checked again, and the other side
+    // publishes before it reads sleepers, so one of both sees the other
+    pthread_mutex_lock( &this->lock );
+    atomic_fetch_add( &this->sleepers, 1 );
+    while( !ready( this ) )
+        pthread_cond_wait( &this->wake, &this->lock );
+    atomic_fetch_sub( &this->sleepers, 1 );
+    pthread_mutex_unlock( &this->lock );
+}
+
+static void pipelineWake( ldacdec_pipeline_t *this )
+{
+    if( atomic_load( &this->sleepers ) == 0 )
+        return;
+    pthread_mutex_lock( &this->lock );
+    pthread_cond_broadcast( &this->wake );
+    pthread_mutex_unlock( &this->lock );
+}
+
+static void *synthesisThread( void *arg )
+{
+    ldacdec_pipeline_t *this = arg;
+
+    for(;;)
+    {
+        pipelineWait( this, hasWork );
+        const unsigned head = atomic_load( &this->head );
+        // quit is only honoured once the ring is empty
+        if( head == atomic_load( &this->tail ) )
+            break;
+
+        pipeline_slot_t *slot = &this->slots[head % PIPELINE_DEPTH];
+        synthesizeFrame( &this->synth, &slot->parsed, slot->pcm );
+        atomic_store( &this->head, head + 1 );
+        pipelineWake( this );
+    }
+    return NULL;
+}
+
+ldacdec_pipeline_t *ldacdecPipelineCreate( void )
+{
+    ldacdec_pipeline_t *this = aligned_alloc( _Alignof(ldacdec_pipeline_t), sizeof(ldacdec_pipeline_t) );
+    if( this == NULL )
+        return NULL;
+    memset( this, 0, sizeof(*this) );
+
+    this->spins = sysconf( _SC_NPROCESSORS_ONLN ) > 1 ? PIPELINE_SPINS : 0;
+    ldacdecInit( &this->parser );
+    ldacdecInit( &this->synth );
+    atomic_init( &this->head, 0 );
+    atomic_init( &this->tail, 0 );
+    atomic_init( &this->sleepers, 0 );
+    atomic_init( &this->quit, 0 );
+    pthread_mutex_init( &this->lock, NULL );
+    pthread_cond_init( &this->wake, NULL );
+
+    if( pthread_create( &this->thread, NULL, synthesisThread, this ) != 0 )
+    {
+        pthread_cond_destroy( &this->wake );
+        pthread_mutex_destroy( &this->lock );
+        free( this );
+        return NULL;
+    }
+    return this;
+}
+
+void ldacdecPipelineDestroy( ldacdec_pipeline_t *this )
+{
+    if( this == NULL )
+        return;
+
+    pthread_mutex_lock( &this->lock );
+    atomic_store( &this->quit, 1 );
+    pthread_cond_broadcast( &this->wake );
+    pthread_mutex_unlock( &this->lock );
+    pthread_join( this->thread, NULL );
+
+    pthread_cond_destroy( &this->wake );
+    pthread_mutex_destroy( &this->lock );
+    free( this );
+}
+
+int ldacDecodeFramesPipelined( ldacdec_pipeline_t *this, const uint8_t *stream, int length, int16_t *pcm, int maxFrames, int *framesDone, int *bytesDone )
+{
+    const frame_t *frame = &this->parser.frame;
+    int frames = 0;
+    int position = 0;
+    int ret = 0;
+
+    while( frames < maxFrames )
+    {
+        pipelineWait( this, hasSpace );
+        const unsigned tail = atomic_load( &this->tail );
+        pipeline_slot_t *slot = &this->slots[tail % PIPELINE_DEPTH];
+
+        ret = parseFrame( &this->parser, stream + position, length - position, &slot->parsed );
+        // incomplete frame at the end of the buffer, leave it to the next call
+        if( ret == LDACDEC_ERR_TRUNCATED )
+        {
+            ret = 0;
+            break;
+        }
+        if( ret < 0 )
+            break;
+
+        slot->pcm = pcm;
+        pcm += frame->frameSamples * frame->channelCount;
+        position += slot->parsed.frameBytes;
+        frames++;
+
+        atomic_store( &this->tail, tail + 1 );
+        pipelineWake( this );
+    }
+
+    // the frames are only complete once synthesis caught up
+    pipelineWait( this, isDrained );
+
+    if( framesDone != NULL )
+        *framesDone = frames;
+    if( bytesDone != NULL )
+        *bytesDone = position;
+    return ret;
+}
+
+int ldacdecPipelineGetSampleRate( ldacdec_pipeline_t *this )
+{
+    return ldacdecGetSampleRate( &this->parser );
+}
+
+int ldacdecPipelineGetChannelCount( ldacdec_pipeline_t *this )
+{
+    return ldacdecGetChannelCount( &this->parser );
+}
@@ -0,0 +1,42 @@
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include "ldacdec.h"
+
+#define LDAC_MAXBLOCKS      (2)
+
+// what synthesis needs of one channel of one block
+typedef struct {
+    int scaleFactors[MAX_QUANT_UNITS];
+    int precisions[MAX_QUANT_UNITS];
+    int precisionsFine[MAX_QUANT_UNITS];
+
+    int quantizedSpectra[MAX_FRAME_SAMPLES];
+    int quantizedSpectraFine[MAX_FRAME_SAMPLES];
+} parsed_channel_t;
+
+// side info of one frame, passed from the parse to the synthesis stage
+typedef struct {
+    int sampleRateId;
+    int channelConfigId;
+    int frameLength;
+    int frameStatus;
+    int frameBytes;
+
+    int blockCount;
+    int quantizationUnitCount[LDAC_MAXBLOCKS];
+    parsed_channel_t channels[LDAC_MAXBLOCKS][2];
+} parsed_frame_t;
+
+// The two halves of decodeBlocks(). Each stage needs its own ldacdec_t, the
+// parser keeps no state between frames, the synthesizer the IMDCT overlap.
+
+// bitstream parsing, returns like ldacDecodeBuffer()
+int parseFrame( ldacdec_t *this, const uint8_t *stream, int length, parsed_frame_t *parsed );
+// dequantization, IMDCT and int16 conversion
+void synthesizeFrame( ldacdec_t *this, const parsed_frame_t *parsed, int16_t *pcm );
+// synthesizeFrame() for count <= MDCT_LANES decoders at once, one SIMD lane
+// each. All frames must have the same sampleRateId and channelConfigId
+void synthesizeFrameLanes( ldacdec_t **decoders, const parsed_frame_t **parsed, int16_t **pcm, int count );
+
+#endif // _PIPELINE_H_
@@ -0,0 +1,72 @@
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "ldacdec.h"
+#include "profile.h"
+
+static const char *stageNames[LDACDEC_STAGE_COUNT] = {
+    "frame",
+    "band",
+    "scale factors",
+    "spectrum",
+    "spectrum fine",
+    "dequantize",
+    "imdct",
+    "pcm",
+};
+
+int ldacdecGetProfile( ldacdec_t *this, ldacdec_profile_t *profile )
+{
+#ifdef PROFILE
+    *profile = this->frame.profile;
+    return 0;
+#else
+    (void)this;
+    memset( profile, 0, sizeof(*profile) );
+    return -1;
+#endif
+}
+
+void ldacdecResetProfile( ldacdec_t *this )
+{
+    memset( &this->frame.profile, 0, sizeof(this->frame.profile) );
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static double seconds( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// measured once, by the first caller
+static pthread_once_t rateOnce = PTHREAD_ONCE_INIT;
+static double rate;
+
+static void measureTickRate( void )
+{
+    const double start = seconds();
+    const uint64_t ticks = profileTicks();
+    double elapsed;
+    while( ( elapsed = seconds() - start ) < 0.01 )
+        ;
+    rate = ( profileTicks() - ticks ) / elapsed;
+}
+#endif
+
+double ldacdecGetProfileTickRate( void )
+{
+#if defined(__x86_64__) || defined(__i386__)
+    pthread_once( &rateOnce, measureTickRate );
+    return rate;
+#else
+    return 1e9;
+#endif
+}
+
+const char *ldacdecGetStageName( ldacdec_stage_t stage )
+{
+    return (unsigned)stage < LDACDEC_STAGE_COUNT ? stageNames[stage] : NULL;
+}
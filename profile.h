@@ -0,0 +1,55 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "ldacdec.h"
+
+/*
+ * Stage timing for a build with PROFILE defined. PROFILE_START() takes a
+ * timestamp, PROFILE_STOP() adds the ticks since then to the histogram of the
+ * stage in the frame's profile. Without PROFILE both expand to nothing.
+ */
+
+static inline uint64_t profileTicks( void )
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
+#endif
+}
+
+static inline void profileRecord( ldacdec_profile_t *this, ldacdec_stage_t stage, uint64_t ticks )
+{
+    ldacdec_stage_profile_t *profile = &this->stages[stage];
+    const int bucket = ticks == 0 ? 0 : 63 - __builtin_clzll( ticks );
+    profile->count++;
+    profile->ticks += ticks;
+    profile->maxTicks = ticks > profile->maxTicks ? ticks : profile->maxTicks;
+    profile->histogram[bucket < LDACDEC_PROFILE_BUCKETS ? bucket : LDACDEC_PROFILE_BUCKETS - 1]++;
+}
+
+#ifdef PROFILE
+
+#define PROFILE_START( start ) \
+    const uint64_t start = profileTicks()
+
+#define PROFILE_STOP( frame, stage, start ) \
+    profileRecord( &(frame)->profile, stage, profileTicks() - start )
+
+#else
+
+#define PROFILE_START( start )
+#define PROFILE_STOP( frame, stage, start )
+
+#endif
+
+#endif // _PROFILE_H_
@@ -56,19 +56,45 @@ static const uint16_t ga_isp_ldac[LDAC_MAXNQUS+1] = {
     256,
 };
 
-static const int decode2DSpectrum[8] = {
-      0,   1,   2,   4,   6,   8,   9,  10 
+/* each code unpacked to its base 4 digits minus one, top digit first; codes above 80 are unused */
+static const int decode2DSpectrum[8][2] = {
+    {-1,-1}, {-1, 0}, {-1, 1}, { 0,-1},
+    { 0, 1}, { 1,-1}, { 1, 0}, { 1, 1},
 };
 
-static const int decode4DSpectrum[128] = {
-      0,   1,   2,   4,   5,   6,   8,   9,  10,  16,  17,  18,  20,  21,  22,  24, 
-     25,  26,  32,  33,  34,  36,  37,  38,  40,  41,  42,  64,  65,  66,  68,  69, 
-     70,  72,  73,  74,  80,  81,  82,  84,  85,  86,  88,  89,  90,  96,  97,  98, 
-    100, 101, 102, 104, 105, 106, 128, 129, 130, 132, 133, 134, 136, 137, 138, 144, 
-    145, 146, 148, 149, 150, 152, 153, 154, 160, 161, 162, 164, 165, 166, 168, 169, 
-    170,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1, 
-     -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1, 
-     -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1,  -1, 
+static const int decode4DSpectrum[128][4] = {
+    {-1,-1,-1,-1}, {-1,-1,-1, 0}, {-1,-1,-1, 1}, {-1,-1, 0,-1},
+    {-1,-1, 0, 0}, {-1,-1, 0, 1}, {-1,-1, 1,-1}, {-1,-1, 1, 0},
+    {-1,-1, 1, 1}, {-1, 0,-1,-1}, {-1, 0,-1, 0}, {-1, 0,-1, 1},
+    {-1, 0, 0,-1}, {-1, 0, 0, 0}, {-1, 0, 0, 1}, {-1, 0, 1,-1},
+    {-1, 0, 1, 0}, {-1, 0, 1, 1}, {-1, 1,-1,-1}, {-1, 1,-1, 0},
+    {-1, 1,-1, 1}, {-1, 1, 0,-1}, {-1, 1, 0, 0}, {-1, 1, 0, 1},
+    {-1, 1, 1,-1}, {-1, 1, 1, 0}, {-1, 1, 1, 1}, { 0,-1,-1,-1},
+    { 0,-1,-1, 0}, { 0,-1,-1, 1}, { 0,-1, 0,-1}, { 0,-1, 0, 0},
+    { 0,-1, 0, 1}, { 0,-1, 1,-1}, { 0,-1, 1, 0}, { 0,-1, 1, 1},
+    { 0, 0,-1,-1}, { 0, 0,-1, 0}, { 0, 0,-1, 1}, { 0, 0, 0,-1},
+    { 0, 0, 0, 0}, { 0, 0, 0, 1}, { 0, 0, 1,-1}, { 0, 0, 1, 0},
+    { 0, 0, 1, 1}, { 0, 1,-1,-1}, { 0, 1,-1, 0}, { 0, 1,-1, 1},
+    { 0, 1, 0,-1}, { 0, 1, 0, 0}, { 0, 1, 0, 1}, { 0, 1, 1,-1},
+    { 0, 1, 1, 0}, { 0, 1, 1, 1}, { 1,-1,-1,-1}, { 1,-1,-1, 0},
+    { 1,-1,-1, 1}, { 1,-1, 0,-1}, { 1,-1, 0, 0}, { 1,-1, 0, 1},
+    { 1,-1, 1,-1}, { 1,-1, 1, 0}, { 1,-1, 1, 1}, { 1, 0,-1,-1},
+    { 1, 0,-1, 0}, { 1, 0,-1, 1}, { 1, 0, 0,-1}, { 1, 0, 0, 0},
+    { 1, 0, 0, 1}, { 1, 0, 1,-1}, { 1, 0, 1, 0}, { 1, 0, 1, 1},
+    { 1, 1,-1,-1}, { 1, 1,-1, 0}, { 1, 1,-1, 1}, { 1, 1, 0,-1},
+    { 1, 1, 0, 0}, { 1, 1, 0, 1}, { 1, 1, 1,-1}, { 1, 1, 1, 0},
+    { 1, 1, 1, 1}, { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2},
+    { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2},
+    { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2},
+    { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2},
+    { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2},
+    { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2},
+    { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2},
+    { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2},
+    { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2},
+    { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2},
+    { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2},
+    { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2}, { 2, 2, 2, 2},
 };
 
 /***************************************************************************************************
@@ -106,24 +132,17 @@ int decodeSpectrum( channel_t *this, BitReaderCxt *br )
             int idxSpectrum = startSubband;
             if( nsps == 2 )
             {
-                int value = decode2DSpectrum[ReadInt( br, LDAC_2DIMSPECBITS )];
-                this->quantizedSpectra[idxSpectrum]   = ((value>>2)&3) - 1;
-                this->quantizedSpectra[idxSpectrum+1] =  (value&3)     - 1;
+                memcpy( &this->quantizedSpectra[idxSpectrum], decode2DSpectrum[ReadInt( br, LDAC_2DIMSPECBITS )], sizeof( decode2DSpectrum[0] ) );
             } else
             {
                 for (int j = 0; j < nsps/4; j++, idxSpectrum+=4)
                 {
-                    int value = decode4DSpectrum[ReadInt( br, LDAC_4DIMSPECBITS )];
-                    this->quantizedSpectra[idxSpectrum]   = ((value>>6)&3) - 1;
-                    this->quantizedSpectra[idxSpectrum+1] = ((value>>4)&3) - 1;
-                    this->quantizedSpectra[idxSpectrum+2] = ((value>>2)&3) - 1;
-                    this->quantizedSpectra[idxSpectrum+3] =  (value&3)     - 1;
+                    memcpy( &this->quantizedSpectra[idxSpectrum], decode4DSpectrum[ReadInt( br, LDAC_4DIMSPECBITS )], sizeof( decode4DSpectrum[0] ) );
                 }
             }
         } else
         {
-            for( int j = startSubband; j<endSubband; ++j )
-                this->quantizedSpectra[j] = ReadSignedInt( br, wl );
+            ReadSignedInts( br, &this->quantizedSpectra[startSubband], endSubband - startSubband, wl );
         }
     }
 
@@ -134,7 +153,6 @@ int decodeSpectrum( channel_t *this, BitReaderCxt *br )
 int decodeSpectrumFine( channel_t *this, BitReaderCxt *br )
 {
     frame_t *frame = this->frame;
-    memset( this->quantizedSpectraFine, 0, sizeof( this->quantizedSpectraFine ) );
     for( int i=0; i<frame->quantizationUnitCount; ++i )
     {
         if( this->precisionsFine[i] > 0 )
@@ -142,10 +160,7 @@ int decodeSpectrumFine( channel_t *this, BitReaderCxt *br )
             int startSubband = ga_isp_ldac[i];
             int endSubband   = ga_isp_ldac[i+1];
             int wl = ga_wl_ldac[this->precisionsFine[i]];
-            for( int j=startSubband; j<endSubband; ++j )
-            {
-                this->quantizedSpectraFine[j] = ReadSignedInt( br, wl );
-            }
+            ReadSignedInts( br, &this->quantizedSpectraFine[startSubband], endSubband - startSubband, wl );
         }
     }
 
@@ -153,67 +168,181 @@ int decodeSpectrumFine( channel_t *this, BitReaderCxt *br )
     return 0;
 }
 
-static void dequantizeQuantUnit( channel_t* this, int band )
+/* 2^(sf - 15), exact in float */
+static const float spectrumScale[32] =
 {
-    const int subBandIndex = ga_isp_ldac[band];
-    const int subBandCount = ga_nsps_ldac[band];
-    const float stepSize = QuantizerStepSize[this->precisions[band]];
-    const float stepSizeFine = QuantizerFineStepSize[this->precisions[band]];
+	3.0517578125e-5, 6.1035156250e-5, 1.2207031250e-4, 2.4414062500e-4,
+	4.8828125000e-4, 9.7656250000e-4, 1.9531250000e-3, 3.9062500000e-3,
+	7.8125000000e-3, 1.5625000000e-2, 3.1250000000e-2, 6.2500000000e-2,
+	1.2500000000e-1, 2.5000000000e-1, 5.0000000000e-1, 1.0000000000e+0,
+	2.0000000000e+0, 4.0000000000e+0, 8.0000000000e+0, 1.6000000000e+1,
+	3.2000000000e+1, 6.4000000000e+1, 1.2800000000e+2, 2.5600000000e+2,
+	5.1200000000e+2, 1.0240000000e+3, 2.0480000000e+3, 4.0960000000e+3,
+	8.1920000000e+3, 1.6384000000e+4, 3.2768000000e+4, 6.5536000000e+4
+};
 
-    for( int sb=0; sb<subBandCount; ++sb )
-    {
-        const double coarse = this->quantizedSpectra[subBandIndex+sb] * stepSize;
-        const double fine = this->quantizedSpectraFine[subBandIndex+sb] * stepSizeFine;
-        this->spectra[subBandIndex + sb] = coarse + fine;
-    }
+#if !defined(KERNEL_VARIANT) || defined(KERNEL_BASELINE)
+int activeSpectrumSize( int quantUnitCount )
+{
+    return ga_isp_ldac[quantUnitCount];
 }
+#endif
 
+/*
+ * Dequantizes and applies the scale factors in one pass over the active
+ * quantization units, then zeroes the unused tail once. The step size and the
+ * power of two scale are combined into one float multiplier, which rounds the
+ * same as scaling the rounded product. Units with fine residuals add them in
+ * double as before.
+ */
 void dequantizeSpectra( channel_t *this )
 {
     frame_t *frame = this->frame;
-    
-    memset( this->spectra, 0, sizeof(this->spectra) );
-    
-    for( int i=0; i<frame->quantizationUnitCount; ++i )
+    const int quantUnitCount = frame->quantizationUnitCount;
+    float * const spectra = this->spectra;
+
+    for( int i=0; i<quantUnitCount; ++i )
     {
-        dequantizeQuantUnit( this, i );
+        const int startSubBand = ga_isp_ldac[i];
+        const int endSubBand   = ga_isp_ldac[i+1];
+        const float scale = this->scaleFactors[i] > 0 ? spectrumScale[this->scaleFactors[i]] : 1.0f;
+        const float stepSize = QuantizerStepSize[this->precisions[i]];
+        const int *quantized = this->quantizedSpectra;
+
+        if( this->precisionsFine[i] == 0 )
+        {
+            const float multiplier = stepSize * scale;
+            for( int sb=startSubBand; sb<endSubBand; ++sb )
+                spectra[sb] = quantized[sb] * multiplier;
+        } else
+        {
+            const float stepSizeFine = QuantizerFineStepSize[this->precisions[i]];
+            const int *quantizedFine = this->quantizedSpectraFine;
+            for( int sb=startSubBand; sb<endSubBand; ++sb )
+            {
+                const double coarse = quantized[sb] * stepSize;
+                const double fine = quantizedFine[sb] * stepSizeFine;
+                spectra[sb] = (float)( coarse + fine ) * scale;
+            }
+        }
     }
-  
+
+    const int activeSubBands = ga_isp_ldac[quantUnitCount];
+    if( activeSubBands < frame->frameSamples )
+        memset( spectra + activeSubBands, 0, ( frame->frameSamples - activeSubBands ) * sizeof( float ) );
+
     LOG_ARRAY_LEN( this->spectra, "%e, ", ga_isp_ldac[frame->quantizationUnitCount-1] + ga_nsps_ldac[frame->quantizationUnitCount-1] ); 
 }
 
-static const double spectrumScale[32] =
-{
-	3.0517578125e-5, 6.1035156250e-5, 1.2207031250e-4, 2.4414062500e-4,
-	4.8828125000e-4, 9.7656250000e-4, 1.9531250000e-3, 3.9062500000e-3,
-	7.8125000000e-3, 1.5625000000e-2, 3.1250000000e-2, 6.2500000000e-2,
-	1.2500000000e-1, 2.5000000000e-1, 5.0000000000e-1, 1.0000000000e+0,
-	2.0000000000e+0, 4.0000000000e+0, 8.0000000000e+0, 1.6000000000e+1,
-	3.2000000000e+1, 6.4000000000e+1, 1.2800000000e+2, 2.5600000000e+2,
-	5.1200000000e+2, 1.0240000000e+3, 2.0480000000e+3, 4.0960000000e+3,
-	8.1920000000e+3, 1.6384000000e+4, 3.2768000000e+4, 6.5536000000e+4
+/* QuantizerStepSize and QuantizerFineStepSize in Q45 */
+static const int64_t QuantizerStepSizeQ45[16] = {
+    70368744177664, 23456248059221, 10052677739666, 4691249611844,
+    2269959489602, 1116964193296, 554084599824, 275955859520,
+    137707914242, 68786651200, 34376523780, 17184064512,
+    8590983296, 4295229456, 2147549186, 1073758208,
+};
+
+static const int64_t QuantizerFineStepSizeQ45[16] = {
+    1073758208, 357919403, 153394030, 71583881,
+    34637362, 17043781, 8454789, 4210817,
+    2101288, 1049617, 524552, 262212,
+    131090, 65541, 32770, 16385,
 };
 
-void scaleSpectrum(channel_t* this)
+/*
+ * Coarse and fine parts are summed exactly in Q45, a 16 bit value times the
+ * largest step still fits 64 bit. The power of two scale only moves the one
+ * rounding shift down to Q(FIXED_FRAC_BITS).
+ */
+void dequantizeSpectraFixed( const channel_t *this, int32_t *spectra )
 {
     const frame_t *frame = this->frame;
-	const int quantUnitCount = frame->quantizationUnitCount;
-	float  * const spectra = this->spectra;
+    const int quantUnitCount = frame->quantizationUnitCount;
+
+    for( int i=0; i<quantUnitCount; ++i )
+    {
+        const int startSubBand = ga_isp_ldac[i];
+        const int endSubBand   = ga_isp_ldac[i+1];
+        // 2^(sf - 15), with sf 0 meaning 1 as in dequantizeSpectra()
+        const int exponent = this->scaleFactors[i] > 0 ? this->scaleFactors[i] - 15 : 0;
+        const int shift = 45 - FIXED_FRAC_BITS - exponent;
+        const int64_t stepSize = QuantizerStepSizeQ45[this->precisions[i]];
+        const int64_t stepSizeFine = this->precisionsFine[i] ? QuantizerFineStepSizeQ45[this->precisions[i]] : 0;
+
+        for( int sb=startSubBand; sb<endSubBand; ++sb )
+        {
+            const int64_t value = this->quantizedSpectra[sb] * stepSize
+                                + this->quantizedSpectraFine[sb] * stepSizeFine;
+            const int64_t rounded = ( value + ( (int64_t)1 << ( shift - 1 ) ) ) >> shift;
+            spectra[sb] = rounded > INT32_MAX ? INT32_MAX : rounded < -INT32_MAX ? -INT32_MAX : rounded;
+        }
+    }
+
+    const int activeSubBands = ga_isp_ldac[quantUnitCount];
+    if( activeSubBands < frame->frameSamples )
+        memset( spectra + activeSubBands, 0, ( frame->frameSamples - activeSubBands ) * sizeof( int32_t ) );
+}
+
+void dequantizeSpectraLanes( const parsed_channel_t * const *channels, const int *quantUnitCounts, int count, int frameSamples, float *spectra )
+{
+    static const int zeros[MAX_FRAME_SAMPLES];
+    int maxQuantUnitCount = 0;
+    for( int lane=0; lane<count; ++lane )
+        maxQuantUnitCount = max( maxQuantUnitCount, quantUnitCounts[lane] );
 
-	for (int i = 0; i < quantUnitCount; i++)
-	{
+    for( int i=0; i<maxQuantUnitCount; ++i )
+    {
         const int startSubBand = ga_isp_ldac[i];
         const int endSubBand   = ga_isp_ldac[i+1];
-        if( this->scaleFactors[i] > 0 )
+        // lanes past their last unit read zeros, so they come out +0 like the memset
+        const int *quantized[MDCT_LANES];
+        float multiplier[MDCT_LANES];
+        int fine = 0;
+
+        for( int lane=0; lane<MDCT_LANES; ++lane )
+        {
+            quantized[lane] = zeros;
+            multiplier[lane] = 0.0f;
+            if( lane >= count || i >= quantUnitCounts[lane] )
+                continue;
+
+            const parsed_channel_t *channel = channels[lane];
+            const float scale = channel->scaleFactors[i] > 0 ? spectrumScale[channel->scaleFactors[i]] : 1.0f;
+            quantized[lane] = channel->quantizedSpectra;
+            multiplier[lane] = QuantizerStepSize[channel->precisions[i]] * scale;
+            fine |= channel->precisionsFine[i];
+        }
+
+        for( int sb=startSubBand; sb<endSubBand; ++sb )
+        {
+            for( int lane=0; lane<MDCT_LANES; ++lane )
+                spectra[sb*MDCT_LANES + lane] = quantized[lane][sb] * multiplier[lane];
+        }
+
+        if( fine == 0 )
+            continue;
+        // rare, the lanes with a residual redo the unit as dequantizeSpectra() does
+        for( int lane=0; lane<count; ++lane )
         {
-	       for (int sb = startSubBand; sb < endSubBand; sb++)
-		   {
-		        spectra[sb] *= spectrumScale[this->scaleFactors[i]];
-		   }
-        } 
-	}
-
-    LOG_ARRAY_LEN( this->spectra, "%e, ", ga_isp_ldac[frame->quantizationUnitCount-1] + ga_nsps_ldac[frame->quantizationUnitCount-1] );
+            const parsed_channel_t *channel = channels[lane];
+            if( i >= quantUnitCounts[lane] || channel->precisionsFine[i] == 0 )
+                continue;
+
+            const float scale = channel->scaleFactors[i] > 0 ? spectrumScale[channel->scaleFactors[i]] : 1.0f;
+            const float stepSize = QuantizerStepSize[channel->precisions[i]];
+            const float stepSizeFine = QuantizerFineStepSize[channel->precisions[i]];
+            for( int sb=startSubBand; sb<endSubBand; ++sb )
+            {
+                const double coarse = channel->quantizedSpectra[sb] * stepSize;
+                const double fine = channel->quantizedSpectraFine[sb] * stepSizeFine;
+                spectra[sb*MDCT_LANES + lane] = (float)( coarse + fine ) * scale;
+            }
+        }
+    }
+
+    const int activeSubBands = ga_isp_ldac[maxQuantUnitCount];
+    if( activeSubBands < frameSamples )
+        memset( spectra + activeSubBands*MDCT_LANES, 0, ( frameSamples - activeSubBands ) * MDCT_LANES * sizeof( float ) );
 }
 
 
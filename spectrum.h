@@ -3,11 +3,20 @@
 
 #include "ldacdec.h"
 #include "bit_reader.h"
+#include "pipeline.h"
 
 int decodeSpectrum( channel_t *this, BitReaderCxt *br );
 int decodeSpectrumFine( channel_t *this, BitReaderCxt *br );
 
+// coefficients covered by the first quantUnitCount units
+int activeSpectrumSize( int quantUnitCount );
+
+// dequantized and scaled spectrum, zero above the last quantization unit
 void dequantizeSpectra( channel_t *this );
-void scaleSpectrum(channel_t* this);
+// dequantizeSpectra() in Q(FIXED_FRAC_BITS), saturated to int32
+void dequantizeSpectraFixed( const channel_t *this, int32_t *spectra );
+// dequantizeSpectra() for up to MDCT_LANES channels of equal frameSamples,
+// lane interleaved as RunImdctLanes() takes it
+void dequantizeSpectraLanes( const parsed_channel_t * const *channels, const int *quantUnitCounts, int count, int frameSamples, float *spectra );
 
 #endif // _SPECTRUM_H_
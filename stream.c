@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ldacdec.h"
+
+/*
+ * Push/pull decoder for byte chunks that do not line up with frames. Frames
+ * lying completely inside a pushed chunk are decoded in place, only the
+ * unfinished rest of a chunk is copied into the reassembly buffer and
+ * completed from the next one. While in sync, a valid header right behind
+ * the last frame is decoded as soon as its frame is complete. Hunting for sync,
+ * which a stream starts with, needs the header after a candidate frame to
+ * confirm it, so the candidate waits for STREAM_LOOKAHEAD bytes behind it.
+ * ldacdecStreamFlush() ends the input, the tail then only has to end exactly
+ * at a frame.
+ */
+
+// decoded frames waiting to be pulled
+#define STREAM_SLOTS        (8)
+// a frame, the slack and the header confirming it
+#define STREAM_LOOKAHEAD    (LDACDEC_MAX_FRAME_BYTES + LDACDEC_SYNC_SLACK + 3)
+#define STREAM_BUFFER_SIZE  (2 * STREAM_LOOKAHEAD)
+
+typedef struct {
+    int16_t pcm[2 * MAX_FRAME_SAMPLES];
+    int sampleRate;
+    int channelCount;
+    int samples;
+    // samples already pulled
+    int offset;
+} stream_slot_t;
+
+struct ldacdec_stream {
+    ldacdec_t decoder;
+    int synced;
+    // no bytes follow the buffered ones, set during ldacdecStreamFlush()
+    int ended;
+    ldacdec_stream_stats_t stats;
+    // of the last decoded frame
+    int sampleRate;
+    int channelCount;
+
+    stream_slot_t slots[STREAM_SLOTS];
+    int head;
+    int count;
+
+    uint8_t buffer[STREAM_BUFFER_SIZE];
+    int pending;
+};
+
+#define NEED_MORE   (-2)
+
+// a valid header within the slack behind the last frame, -1 if there is none
+static int syncedFrame( const uint8_t *data, int length, int position, ldacdec_header_t *header )
+{
+    for( int q = position; q <= position + LDACDEC_SYNC_SLACK; ++q )
+    {
+        const int ret = ldacdecPeekHeader( data + q, length - q, header );
+        if( ret == LDACDEC_ERR_TRUNCATED )
+            return NEED_MORE;
+        if( ret == 0 )
+            return header->frameBytes <= length - q ? q : NEED_MORE;
+    }
+    return -1;
+}
+
+// decodes frames from data until it runs out of bytes or slots, returns the
+// bytes it is done with
+static int consume( ldacdec_stream_t *this, const uint8_t *data, int length )
+{
+    int position = 0;
+    while( this->count < STREAM_SLOTS )
+    {
+        ldacdec_header_t header;
+        int frame = this->synced ? syncedFrame( data, length, position, &header ) : -1;
+        if( frame == NEED_MORE && !this->ended )
+            break;
+        if( frame < 0 )
+        {
+            this->synced = 0;
+            // a candidate up to limit has its frame and confirmation in data,
+            // at the end of the input one that ends exactly there confirms itself
+            const int limit = this->ended ? length : length - STREAM_LOOKAHEAD;
+            if( limit <= position )
+                break;
+            const int64_t found = ldacdecFindFrame( data, length, position, &header );
+            if( found < 0 || found > limit )
+            {
+                this->stats.skippedBytes += limit - position;
+                position = limit;
+                break;
+            }
+            frame = found;
+        }
+        this->stats.skippedBytes += frame - position;
+
+        stream_slot_t *slot = &this->slots[(this->head + this->count) % STREAM_SLOTS];
+        if( ldacDecodeBuffer( &this->decoder, data + frame, header.frameBytes, slot->pcm, NULL ) < 0 )
+        {
+            this->stats.droppedFrames++;
+            this->stats.skippedBytes++;
+            this->synced = 0;
+            position = frame + 1;
+            continue;
+        }
+        slot->sampleRate = this->sampleRate = header.sampleRate;
+        slot->channelCount = this->channelCount = header.channelCount;
+        slot->samples = ldacdecGetOutputSamples( &this->decoder );
+        slot->offset = 0;
+        this->count++;
+        this->stats.frames++;
+        this->synced = 1;
+        position = frame + header.frameBytes;
+    }
+    return position;
+}
+
+ldacdec_stream_t *ldacdecStreamCreate( void )
+{
+    ldacdec_stream_t *this = malloc( sizeof(*this) );
+    if( this != NULL )
+        ldacdecStreamReset( this );
+    return this;
+}
+
+void ldacdecStreamDestroy( ldacdec_stream_t *this )
+{
+    free( this );
+}
+
+void ldacdecStreamReset( ldacdec_stream_t *this )
+{
+    memset( this, 0, sizeof(*this) );
+    ldacdecInit( &this->decoder );
+}
+
+int ldacdecPush( ldacdec_stream_t *this, const uint8_t *bytes, int length )
+{
+    int used = 0;
+
+    // complete what earlier chunks left in the buffer, until the frames in it
+    // reach into bytes
+    while( this->pending > 0 )
+    {
+        const int old = this->pending;
+        const int copy = min( length - used, STREAM_BUFFER_SIZE - old );
+        memcpy( this->buffer + old, bytes + used, copy );
+        this->pending += copy;
+
+        const int done = consume( this, this->buffer, this->pending );
+        if( done >= old )
+        {
+            used += done - old;
+            this->pending = 0;
+            break;
+        }
+        this->pending -= done;
+        memmove( this->buffer, this->buffer + done, this->pending );
+        used += copy;
+        if( copy == 0 )
+            return used;
+    }
+
+    used += consume( this, bytes + used, length - used );
+    // with slots left consume() only stopped short of a frame, which is less
+    // than STREAM_LOOKAHEAD bytes
+    if( this->count < STREAM_SLOTS )
+    {
+        this->pending = length - used;
+        memcpy( this->buffer, bytes + used, this->pending );
+        used = length;
+    }
+    return used;
+}
+
+int ldacdecStreamFlush( ldacdec_stream_t *this )
+{
+    this->ended = 1;
+    const int done = consume( this, this->buffer, this->pending );
+    this->ended = 0;
+    this->pending -= done;
+    memmove( this->buffer, this->buffer + done, this->pending );
+    // consume() only stops short of the end with every slot taken
+    if( this->pending > 0 )
+        return LDACDEC_ERR_BUSY;
+    this->synced = 0;
+    return 0;
+}
+
+int ldacdecPull( ldacdec_stream_t *this, int16_t *pcm, int maxSamples )
+{
+    const stream_slot_t *first = &this->slots[this->head];
+    int samples = 0;
+    while( this->count > 0 && samples < maxSamples )
+    {
+        stream_slot_t *slot = &this->slots[this->head];
+        // one call only returns samples of one format
+        if( slot->sampleRate != first->sampleRate || slot->channelCount != first->channelCount )
+            break;
+
+        const int channels = slot->channelCount;
+        const int take = min( slot->samples - slot->offset, maxSamples - samples );
+        memcpy( pcm + samples * channels, slot->pcm + slot->offset * channels, take * channels * sizeof(int16_t) );
+        samples += take;
+        slot->offset += take;
+        if( slot->offset == slot->samples )
+        {
+            this->head = (this->head + 1) % STREAM_SLOTS;
+            this->count--;
+        }
+    }
+    return samples;
+}
+
+int ldacdecStreamGetSampleRate( ldacdec_stream_t *this )
+{
+    return this->count > 0 ? this->slots[this->head].sampleRate : this->sampleRate;
+}
+
+int ldacdecStreamGetChannelCount( ldacdec_stream_t *this )
+{
+    return this->count > 0 ? this->slots[this->head].channelCount : this->channelCount;
+}
+
+void ldacdecStreamGetStats( ldacdec_stream_t *this, ldacdec_stream_stats_t *stats )
+{
+    *stats = this->stats;
+}
@@ -14,12 +14,6 @@ uint32_t BitReverse32(uint32_t value, int bitCount)
 	return value >> (32 - bitCount);
 }
 
-int32_t SignExtend32(int32_t value, int bits)
-{
-	const int shift = 8 * sizeof(int32_t) - bits;
-	return (value << shift) >> shift;
-}
-
 int16_t Clamp16(int value)
 {
 	if (value > SHRT_MAX)
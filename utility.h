@@ -13,7 +13,12 @@
 int Max(int a, int b);
 int Min(int a, int b);
 uint32_t BitReverse32(uint32_t value, int bitCount);
-int32_t SignExtend32(int32_t value, int bits);
 int16_t Clamp16(int value);
 int Round(double x);
 
+
+static inline int32_t SignExtend32(int32_t value, int bits)
+{
+	const int shift = 8 * sizeof(int32_t) - bits;
+	return (int32_t)((uint32_t)value << shift) >> shift;
+}